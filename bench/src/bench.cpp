@@ -0,0 +1,268 @@
+#include "include.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fcntl.h>
+#include <map>
+#include <sstream>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// phases of solving an isomer, each is timed separately. Build, optimize and
+// write are timed by the engines as for the columns of --stats
+enum Phase { PARSE, DUAL, BOUNDS, BUILD, OPTIMIZE, VERIFY, WRITE, NPHASE };
+const string PHASE_NAMES[NPHASE] = {"parse",    "dual",   "bounds", "build",
+                                    "optimize", "verify", "write"};
+
+// the timings of the isomers on one number of vertices, in microseconds
+struct Size_stats {
+  vector<double> phase_us[NPHASE];
+};
+
+double percentile(vector<double> times, const double q) {
+  if (times.empty())
+    return 0;
+  sort(times.begin(), times.end());
+  const size_t rank = (size_t)ceil(q * times.size());
+  return times[rank == 0 ? 0 : rank - 1];
+}
+
+// Write the (5,0) nanotube fullerenes on 20 to max_n vertices (C20, then one
+// more belt of hexagons per 10 vertices) in the adjacency list format. The
+// vertices are in layers of 5 around the tube axis, the layers are joined by
+// alternately 5 parallel edges and a zigzag of 10 edges, the first and last
+// layers being the pentagons of the caps.
+void gen_tubes(const int max_n) {
+  for (int n = 20; n <= max_n; n += 10) {
+    const int num_layers = n / 5;
+    vector<double> pos(3 * n), normal(3 * n);
+    double shift = 0;
+    for (int j = 0; j < num_layers; j++) {
+      const bool cap = j == 0 || j == num_layers - 1;
+      for (int i = 0; i < 5; i++) {
+        const double phi = 2 * M_PI * (i + shift) / 5, r = cap ? 0.5 : 1;
+        const int v = 5 * j + i;
+        pos[3 * v] = r * cos(phi);
+        pos[3 * v + 1] = r * sin(phi);
+        pos[3 * v + 2] = -j;
+        normal[3 * v] = cap ? 0 : cos(phi);
+        normal[3 * v + 1] = cap ? 0 : sin(phi);
+        normal[3 * v + 2] = j == 0 ? 1 : (cap ? -1 : 0);
+      }
+      // the layer after a zigzag sits between the vertices of this one
+      if (j % 2 == 1)
+        shift += 0.5;
+    }
+    cout << n << endl;
+    for (int j = 0; j < num_layers; j++) {
+      for (int i = 0; i < 5; i++) {
+        vector<int> adj;
+        if (j == 0 || j == num_layers - 1) {
+          adj.push_back(5 * j + (i + 4) % 5);
+          adj.push_back(5 * j + (i + 1) % 5);
+        }
+        // the joins alternate, parallel after even layers, zigzag after odd
+        if (j > 0) {
+          adj.push_back(5 * (j - 1) + i);
+          if (j % 2 == 0)
+            adj.push_back(5 * (j - 1) + (i + 1) % 5);
+        }
+        if (j < num_layers - 1) {
+          adj.push_back(5 * (j + 1) + i);
+          if (j % 2 == 1)
+            adj.push_back(5 * (j + 1) + (i + 4) % 5);
+        }
+        // order the neighbours clockwise around the outward normal
+        const int v = 5 * j + i;
+        const double *nv = &normal[3 * v];
+        const double e1[3] = {fabs(nv[2]) > 0.5 ? 1.0 : 0.0, 0,
+                              fabs(nv[2]) > 0.5 ? 0.0 : 1.0};
+        const double e2[3] = {nv[1] * e1[2] - nv[2] * e1[1],
+                              nv[2] * e1[0] - nv[0] * e1[2],
+                              nv[0] * e1[1] - nv[1] * e1[0]};
+        vector<pair<double, int>> order;
+        for (int u : adj) {
+          double d[3], x = 0, y = 0;
+          for (int c = 0; c < 3; c++) {
+            d[c] = pos[3 * u + c] - pos[3 * v + c];
+            x += d[c] * e1[c];
+            y += d[c] * e2[c];
+          }
+          order.push_back(make_pair(-atan2(y, x), u));
+        }
+        sort(order.begin(), order.end());
+        cout << setw(2) << 3;
+        for (auto &o : order) {
+          cout << " " << setw(2) << o.second;
+        }
+        cout << endl;
+      }
+    }
+  }
+}
+
+// solve the isomers of one file with the engines of clar, against the same
+// upper bounds and with the same parameters, adding the time of each phase to
+// stats. With dual_only the isomers are only read and their duals built
+int bench_file(const string name, const Options(&opts), const bool dual_only,
+               GRBEnv(&grb_env), map<int, Size_stats>(&stats)) {
+  const int fd = open(name.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw runtime_error("\nError: Could not open file " + name);
+  Input in(fd);
+  const int p = opts.p_vals[0];
+  ostringstream out_bufs[NFILE];
+  vector<Out_ptrs> out_files_ptr(1);
+  for (int i = 0; i < NFILE; i++) {
+    out_files_ptr[0][i] = &out_bufs[i];
+  }
+  Fullerene F;
+  vector<int> bounds, clar_nums(1);
+  vector<string> certs;
+  vector<Clar_sol> sols(1);
+  int num_isomers = 0;
+  Clock::time_point start = Clock::now();
+  while (read_fullerene(in, F, p)) {
+    F.id = num_isomers++;
+    F.stats = Isomer_stats();
+    vector<double> *phase_us = stats[F.n].phase_us;
+    phase_us[PARSE].push_back(lap_us(start));
+    construct_planar_dual(F, p);
+    phase_us[DUAL].push_back(lap_us(start));
+    if (dual_only)
+      continue;
+
+    // the engines time the model (build), the heuristic and the search
+    // (optimize) and the rows (write) themselves, what is left is mostly
+    // checking the structures
+    screen_bounds(F, opts, bounds, certs);
+    phase_us[BOUNDS].push_back(lap_us(start));
+    if (opts.engine == NATIVE) {
+      p_range_anionic_clar_native(F, opts, bounds, out_files_ptr, clar_nums,
+                                  sols);
+    } else {
+      p_range_anionic_clar_lp(F, opts, bounds, grb_env, out_files_ptr,
+                              clar_nums, sols);
+    }
+    const double solve_us = lap_us(start);
+    // the native engine has no model to build
+    if (opts.engine != NATIVE)
+      phase_us[BUILD].push_back(F.stats.build_us);
+    phase_us[OPTIMIZE].push_back(F.stats.optimize_us);
+    phase_us[VERIFY].push_back(max(0.0, solve_us - F.stats.build_us -
+                                            F.stats.optimize_us -
+                                            F.stats.write_us));
+    phase_us[WRITE].push_back(F.stats.write_us);
+    for (int i = 0; i < NFILE; i++) {
+      out_bufs[i].str("");
+    }
+  }
+  close(fd);
+  return num_isomers;
+}
+
+void print_phases(const Size_stats(&size_stats), const string indent) {
+  bool first = true;
+  for (int ph = 0; ph < NPHASE; ph++) {
+    const vector<double> &times = size_stats.phase_us[ph];
+    if (times.empty())
+      continue;
+    cout << (first ? "" : ",\n") << indent << "\"" << PHASE_NAMES[ph]
+         << "\": {\"p50_us\": " << percentile(times, 0.5)
+         << ", \"p99_us\": " << percentile(times, 0.99) << "}";
+    first = false;
+  }
+  cout << "\n";
+}
+
+// peak resident set size of the process in kB
+long peak_rss_kb() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  // macOS reports it in bytes
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+int main(int argc, char *argv[]) {
+  const string usage = "\nUsage: bench {p} [--engine gurobi|native] "
+                       "[--repeat R] [--dual-only] {files of fullerenes}"
+                       "\n       bench --gen-tubes {max n}";
+  if (argc == 3 && string(argv[1]) == "--gen-tubes") {
+    gen_tubes(atoi(argv[2]));
+    return 0;
+  }
+  if (argc < 3)
+    throw runtime_error("\nError: Missing arguments" + usage);
+  Options opts;
+  opts.p_vals.push_back(atoi(argv[1]));
+  int repeat = 1;
+  bool dual_only = false;
+  vector<string> files;
+  for (int i = 2; i < argc; i++) {
+    const string arg = argv[i];
+    if (arg == "--engine" && i + 1 < argc) {
+      const string engine = argv[++i];
+      if (engine != "gurobi" && engine != "native")
+        throw runtime_error("\nError: Unknown engine " + engine + usage);
+      opts.engine = engine == "native" ? NATIVE : GUROBI;
+    } else if (arg == "--repeat" && i + 1 < argc) {
+      repeat = max(1, atoi(argv[++i]));
+    } else if (arg == "--dual-only") {
+      dual_only = true;
+    } else {
+      files.push_back(arg);
+    }
+  }
+
+  GRBEnv grb_env = GRBEnv(true);
+  if (opts.engine == GUROBI && !dual_only) {
+    grb_env.set(GRB_IntParam_OutputFlag, DEBUG_GUROBI);
+    grb_env.set(GRB_IntParam_Threads, 1);
+    grb_env.start();
+  }
+
+  // every file is solved repeat times, the timings are kept per size
+  map<int, Size_stats> stats;
+  long num_isomers = 0;
+  const Clock::time_point start = Clock::now();
+  for (int r = 0; r < repeat; r++) {
+    for (const string &file : files) {
+      num_isomers += bench_file(file, opts, dual_only, grb_env, stats);
+    }
+  }
+  const double seconds =
+      chrono::duration<double>(Clock::now() - start).count();
+
+  Size_stats all;
+  for (auto &s : stats) {
+    for (int ph = 0; ph < NPHASE; ph++) {
+      const vector<double> &times = s.second.phase_us[ph];
+      all.phase_us[ph].insert(all.phase_us[ph].end(), times.begin(),
+                              times.end());
+    }
+  }
+  cout << fixed << setprecision(1);
+  cout << "{\n  \"p\": " << opts.p_vals[0] << ",\n  \"engine\": \""
+       << (opts.engine == NATIVE ? "native" : "gurobi") << "\",\n"
+       << "  \"isomers\": " << num_isomers << ",\n  \"seconds\": "
+       << setprecision(3) << seconds << setprecision(1)
+       << ",\n  \"isomers_per_sec\": "
+       << (seconds > 0 ? num_isomers / seconds : 0)
+       << ",\n  \"peak_rss_kb\": " << peak_rss_kb() << ",\n  \"phases\": {\n";
+  print_phases(all, "    ");
+  cout << "  },\n  \"sizes\": [";
+  bool first = true;
+  for (auto &s : stats) {
+    cout << (first ? "\n" : ",\n") << "    {\"n\": " << s.first
+         << ", \"isomers\": " << s.second.phase_us[PARSE].size()
+         << ", \"phases\": {\n";
+    print_phases(s.second, "      ");
+    cout << "    }}";
+    first = false;
+  }
+  cout << "\n  ]\n}" << endl;
+}
@@ -1,6 +1,11 @@
 #include "gurobi_c++.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
 #include <fstream>
 #include <iomanip>
+#include <mutex>
+#include <unordered_map>
 
 using namespace std;
 
@@ -14,7 +19,25 @@ using namespace std;
 //-------- HERE BE DRAGONS --------
 
 // number of out files
-constexpr int NFILE = 4;
+constexpr int NFILE = 8;
+// the out file of the automorphism group orders, only written with --symmetry
+constexpr int AUT_FILE = 4;
+// the out files of the numbers of Clar structures and of their sets of
+// resonant faces, only written with --count-structures and --list-structures
+constexpr int COUNT_FILE = 5;
+constexpr int FACES_FILE = 6;
+// the out file of the bounds on the Clar numbers, only written with --screen
+constexpr int BOUNDS_FILE = 7;
+
+// the out streams of one value of p
+typedef array<ostream *, NFILE> Out_ptrs;
+
+// The graph is stored as one vector each of fixed size vertex, face and edge
+// structs. Every vertex has degree 3 and every face at most 6 sides, so this
+// is already a flat array indexed by id, with no offsets to look up as a CSR
+// layout would need. The vectors keep their capacity when a Fullerene is
+// reused for the next isomer, so reading it and building its dual allocate
+// nothing once the largest size has been seen
 
 // information on each vertex
 struct vertex {
@@ -24,6 +47,8 @@ struct vertex {
   int faces[3];
   // edges it is an endpoint of
   int edges[3];
+  // position of it in the adj list of each of its neighbours
+  int ports[3];
 };
 
 // information on each face
@@ -43,10 +68,96 @@ struct edge {
   int vertices[2];
 };
 
+typedef chrono::steady_clock Clock;
+
+// time since start in microseconds, start is moved on to now
+inline double lap_us(Clock::time_point(&start)) {
+  const Clock::time_point now = Clock::now();
+  const double us = chrono::duration<double, micro>(now - start).count();
+  start = now;
+  return us;
+}
+
+// what solving an isomer took, summed over the values of p. Times are in
+// microseconds
+struct Isomer_stats {
+  Isomer_stats()
+      : read_us(0), dual_us(0), build_us(0), optimize_us(0), write_us(0),
+        nodes(0), grb_runtime_us(0), grb_work(0) {}
+  // reading the isomer, constructing its dual (and automorphisms), building
+  // the models, solving (including the heuristic) and writing the rows
+  double read_us, dual_us, build_us, optimize_us, write_us;
+  // branch and bound nodes explored by Gurobi, its own run time and its
+  // deterministic work (which does not depend on the load of the machine)
+  double nodes, grb_runtime_us, grb_work;
+};
+
+// a set of ids, one bit each. Bit i is bit i % 64 of word i / 64, so on a
+// little endian machine the words are laid out as the bitsets of the binary
+// out files
+class Bitset {
+public:
+  Bitset() : num_bits(0) {}
+  // size ids, none of them in the set
+  void assign(const int size) {
+    num_bits = size;
+    words.assign((size + 63) / 64, 0);
+  }
+  void clear() { assign(0); }
+  bool empty() const { return num_bits == 0; }
+  int size() const { return num_bits; }
+  bool operator[](const int i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+  void set(const int i) { words[i >> 6] |= uint64_t(1) << (i & 63); }
+  // number of ids in the set
+  int count() const {
+    int num = 0;
+    for (uint64_t w : words) {
+      num += __builtin_popcountll(w);
+    }
+    return num;
+  }
+  // byte b of the set, ids 8b to 8b + 7
+  unsigned char byte(const int b) const {
+    return (words[b >> 3] >> (8 * (b & 7))) & 0xff;
+  }
+  void set_byte(const int b, const unsigned char val) {
+    words[b >> 3] |= uint64_t(val) << (8 * (b & 7));
+  }
+  // number of ids in both sets, of the same size
+  int count_and(const Bitset(&other)) const {
+    int num = 0;
+    for (size_t w = 0; w < words.size(); w++) {
+      num += __builtin_popcountll(words[w] & other.words[w]);
+    }
+    return num;
+  }
+  // call fn(i) for each id i in the set, in increasing order
+  template <class Fn> void for_each(Fn fn) const {
+    for (size_t w = 0; w < words.size(); w++) {
+      for (uint64_t bits = words[w]; bits; bits &= bits - 1) {
+        fn(int(64 * w) + __builtin_ctzll(bits));
+      }
+    }
+  }
+
+private:
+  int num_bits;
+  vector<uint64_t> words;
+};
+
+// The vertices of each face and edge as masks over the words of a bitset of
+// the vertices, so that a structure is checked a word at a time. Face f has
+// the masks start[f] to start[f + 1] - 1, edge e those of dual_n + e. Mask j
+// is bits[j] on word word[j]
+struct Vertex_masks {
+  vector<int> start, word;
+  vector<uint64_t> bits;
+};
+
 // information on each fullerene isomer
 class Fullerene {
 public:
-  Fullerene() : n(0), dual_n(0), num_edges(0), id(0) {}
+  Fullerene() : n(0), dual_n(0), num_edges(0), id(0), offset(0) {}
   // resize fullerene
   void Resize(int num_vertices) {
     n = num_vertices;
@@ -63,35 +174,446 @@ public:
   // Attributes
   int n, dual_n, num_edges,
       id;                // size of primal, size of dual, # of edges, and id
+  size_t offset;         // byte offset of the input just after the isomer
+  // filled in as the isomer is solved, by solvers that only see a const
+  // Fullerene
+  mutable Isomer_stats stats;
   vector<vertex> primal; // planar graph information
   vector<face> dual;     // planar dual graph information
   vector<edge> edges;    // edge information
+  vector<int> pents;     // ids of the pentagons, in increasing order
+  vector<int> hexes;     // ids of the hexagons, in increasing order
+  Bitset pent_mask;      // the pentagons as a set of face ids
+  Vertex_masks masks;    // the vertices of the faces and edges
+  // automorphisms of the embedding as permutations of the faces, only
+  // computed with --symmetry
+  vector<vector<int>> aut_faces;
+};
+
+// A p-anionic resonance structure, as found by any of the solvers. Gurobi's
+// solution is read into one in bulk after the solve, and verification and
+// every out file work from it, so they do not depend on the solver. Empty if
+// there is no structure
+struct Clar_sol {
+  // res_face[f] = 1 if face f is resonant and 0 otherwise
+  Bitset res_face;
+  // match_e[i] = 1 if edge i is a matching edge and 0 otherwise
+  Bitset match_e;
+};
+
+// the p-anionic Clar structures of an isomer
+struct Clar_count {
+  Clar_count() : num_face_sets(0), num_structures(0) {}
+  // number of sets of resonant faces of the Clar structures
+  long num_face_sets;
+  // number of Clar structures, i.e. of pairs of such a set and a perfect
+  // matching of the remaining vertices
+  long num_structures;
+  // the sets of resonant faces, in increasing order of face id, if listed
+  vector<vector<int>> face_sets;
+};
+
+// solvers for the p-anionic Clar number
+enum Engine { GUROBI, NATIVE };
+
+// Gurobi parameters for the isomers of n_first to n_last vertices and a value
+// of p, as found by --tune. -1 leaves Presolve and Cuts to Gurobi, as does 0
+// for MIPFocus
+struct Grb_params {
+  Grb_params()
+      : n_first(0), n_last(0), p(0), presolve(-1), cuts(-1), mip_focus(0) {}
+  int n_first, n_last, p;
+  int presolve, cuts, mip_focus;
+};
+
+// run time options, set from the command line
+struct Options {
+  Options()
+      : num_threads(1), batch_size(1), engine(GUROBI), match_heuristic(false),
+        binary_out(false), checkpoint_every(0), resume(false),
+        symmetry(false), heuristic_only(false), shard(0), num_shards(1),
+        merge_shards(0), to_stdout(false), count_structures(false),
+        list_structures(false), progress_secs(0), tune_samples(5),
+        screen(false) {}
+  // values of p to solve for, each gets its own set of out files
+  vector<int> p_vals;
+  // number of worker threads, 1 solves every isomer on the main thread
+  int num_threads;
+  // number of isomers each worker solves together in one Gurobi model
+  int batch_size;
+  // solver used for each isomer
+  Engine engine;
+  // try to complete the LP relaxations into solutions with a matching oracle
+  bool match_heuristic;
+  // write one binary file per value of p instead of the text out files
+  bool binary_out;
+  // binary out file to convert to the text out files, if any
+  string bin_to_text;
+  // save a checkpoint every this many isomers, 0 for never
+  int checkpoint_every;
+  // continue from the last checkpoint
+  bool resume;
+  // use the automorphism group to break symmetry in the ILP
+  bool symmetry;
+  // file of solutions kept between runs, if any
+  string cache_file;
+  // only run the heuristic, the numbers written are lower bounds
+  bool heuristic_only;
+  // solve block shard of num_shards blocks of the isomers, 0 of 1 is all
+  int shard, num_shards;
+  // file of the offsets of the isomers, shared by the shards, if any
+  string index_file;
+  // number of shards to merge into the out files, 0 for none
+  int merge_shards;
+  // write the solutions to stdout instead of the out files
+  bool to_stdout;
+  // count the Clar structures of each isomer, and also list their sets of
+  // resonant faces
+  bool count_structures, list_structures;
+  // seconds between progress lines on stderr, 0 for none
+  int progress_secs;
+  // file to write the Isomer_stats of each isomer to as csv, if any
+  string stats_file;
+  // file to save the Gurobi parameters tuned on the input to, if any, and
+  // the number of isomers of each bucket of sizes they are tuned on
+  string tune_file;
+  int tune_samples;
+  // Gurobi parameters to solve with, loaded from a file saved by --tune
+  vector<Grb_params> params;
+  // write the bounds on the Clar numbers and whether they settle them
+  bool screen;
+};
+
+// counts kept over a run, reported at the end
+struct Run_stats {
+  Run_stats() : num_solves(0), num_by_bound(0) {}
+  // values of p solved by an engine, summed over the isomers
+  long num_solves;
+  // of those, the ones settled by the upper bound, either because there is
+  // no structure or because the solve stopped on a structure meeting it
+  long num_by_bound;
+};
+
+// the out files of a run, one set for each value of p. Files that are not
+// used (e.g. with binary output) have an empty name
+struct Out_files {
+  vector<array<ofstream, NFILE>> files;
+  vector<array<string, NFILE>> names;
+};
+
+// From input.cpp
+// formats the isomers can be read in
+enum Format { ADJ_LIST, PLANAR_CODE };
+
+// Source of the isomers, either in the adjacency list format or in binary
+// planar_code (detected from its header). Regular files are memory mapped and
+// parsed in place, anything else (e.g. a pipe) is read through a buffer.
+class Input {
+public:
+  Input(const int fd);
+  ~Input();
+  Input(const Input &) = delete;
+  Input &operator=(const Input &) = delete;
+  // read the next integer, returns false at the end of the input or if the
+  // next token is not an integer
+  bool next_int(int(&x));
+  // read the next planar_code entry, 1 byte or 2 bytes if wide
+  bool next_entry(unsigned(&x), const bool wide);
+  Format format() const { return fmt; }
+  // byte offset of the next unread character
+  size_t offset() const;
+  // the following require the input to be memory mapped
+  bool is_mapped() const { return mapped; }
+  // byte offset the input ends at, as limited
+  size_t size() const { return end - map; }
+  // jump to a byte offset, e.g. one given by index_isomers
+  void seek(const size_t off);
+  // byte offsets of the isomers from the current offset on
+  vector<size_t> index_isomers();
+  // stop reading at a byte offset, as if the input ended there
+  void limit(const size_t off);
+
+private:
+  void refill();
+  void skip_space();
+  void detect_format();
+  bool skip_isomer();
+
+  const int fd;
+  bool mapped, eof;
+  char *map;
+  size_t map_size;
+  vector<char> buffer;
+  const char *cur, *end;
+  // byte offset of the start of the buffer
+  size_t base;
+  Format fmt;
+  // byte order of 2 byte planar_code entries
+  bool big_endian;
 };
 
 // From read_and_print.cpp
+// the binary out files start with this header followed by one byte for p
+const string BIN_HEADER = ">>clar_sol<<";
 void throw_error(const int n, const int p, const int graph_id,
                  string error_message);
-bool read_fullerene(Fullerene(&F), const int p);
-void print_primal(const int n, const vector<vertex> primal);
-void print_dual(const int dual_n, const vector<face> dual);
+bool read_fullerene(Input(&in), Fullerene(&F), const int p);
+void print_primal(const int n, const vector<vertex>(&primal));
+void print_dual(const int dual_n, const vector<face>(&dual));
 void print_sol(const Fullerene(&F), const int num_res_faces,
-               const vector<GRBVar> fvars, const vector<GRBVar> evars);
+               const Clar_sol(&sol));
 void save_sol(const Fullerene(&F), const int p, const int num_res_faces,
-              const vector<GRBVar> fvars, const vector<GRBVar> evars,
-              ofstream out_files_ptr[NFILE]);
+              const Clar_sol(&sol), ostream *out_files_ptr[NFILE]);
+void save_sol_bin(const Fullerene(&F), const int num_res_faces,
+                  const Clar_sol(&sol), ostream(&out));
+bool read_sol_bin(istream(&in), const Fullerene(&F), int(&num_res_faces),
+                  Clar_sol(&sol));
+void save_clar_count(const Clar_count(&count), const bool list,
+                     ostream *out_files_ptr[NFILE]);
+void write_sol(const Fullerene(&F), const Options(&opts), const int p,
+               const int num_res_faces, const Clar_sol(&sol),
+               ostream *out_files_ptr[NFILE]);
+void open_bin_file(const int p, const string suffix, string(&name),
+                   ofstream(&out_file));
+string shard_suffix(const Options(&opts));
+void bin_to_text(const string bin_name, Input(&in));
 void get_out_name(const int p, string &fname);
 void open_out_file(const int p, string (&out_file_names)[NFILE],
                    ofstream out_files_ptr[NFILE]);
 void close_files(ofstream out_files_ptr[NFILE]);
+void get_out_ptrs(ofstream out_files[NFILE], ostream *out_files_ptr[NFILE]);
+void open_out_files(const Options(&opts), Out_files(&out));
+void close_out_files(Out_files(&out));
 
 // From dual.cpp
-int find_position(const int v, const int u, int v_adj[3]);
-int counter_clockwise_walk(const int face_id, int u, int v, const int n,
+void find_ports(Fullerene(&F), const int p);
+int counter_clockwise_walk(const int face_id, int u, int pos,
                            vector<vertex>(&primal), face(&cur_face));
 void construct_planar_dual(Fullerene(&F), const int p);
 
 // From lp.cpp
 int check_if_sol_valid(const Fullerene(&F), const int p,
-                       const vector<GRBVar> fvars, const vector<GRBVar> evars);
-int p_anionic_clar_lp(const Fullerene(&F), const int p, GRBEnv grb_env,
-                      ofstream out_files_ptr[NFILE]);
+                       const Clar_sol(&sol));
+void check_sols_valid(const vector<const Fullerene *>(&batch), const int p,
+                      const vector<const Clar_sol *>(&sols),
+                      vector<int>(&num_res_faces));
+void get_sol(const Fullerene(&F), GRBModel(&model),
+             const vector<GRBVar>(&fvars), const vector<GRBVar>(&evars),
+             Clar_sol(&sol));
+GRBConstr add_cons(const Fullerene(&F), const int p, GRBModel(&model),
+                   vector<GRBVar>(&fvars), vector<GRBVar>(&evars));
+void add_vars(const Fullerene(&F), const int p, GRBModel(&model),
+              vector<GRBVar>(&fvars), vector<GRBVar>(&evars));
+// The engines solve for each value of p in opts, given the upper bounds on the
+// Clar numbers (see screen_bounds)
+int p_range_anionic_clar_lp(const Fullerene(&F), const Options(&opts),
+                            const vector<int>(&bounds), GRBEnv(&grb_env),
+                            vector<Out_ptrs>(&out_files_ptr),
+                            vector<int>(&clar_nums), vector<Clar_sol>(&sols));
+int batch_anionic_clar_lp(const vector<const Fullerene *>(&batch),
+                          const Options(&opts),
+                          const vector<vector<int>>(&bounds), GRBEnv(&grb_env),
+                          vector<vector<Out_ptrs>>(&out_files_ptr),
+                          vector<vector<int>>(&clar_nums),
+                          vector<vector<Clar_sol>>(&sols));
+int p_anionic_clar_lp(const Fullerene(&F), const int p, GRBEnv(&grb_env),
+                      ostream *out_files_ptr[NFILE]);
+const Grb_params &find_params(const Options(&opts), const int n, const int p);
+void set_params(GRBModel(&model), const Grb_params(&params));
+
+// From matching.cpp
+// sum and product of counts of Clar structures, an error if they overflow
+long add_counts(const Fullerene(&F), const int p, const long a, const long b);
+long mul_counts(const Fullerene(&F), const int p, const long a, const long b);
+// Counts the resonance structures of an isomer with a given number of
+// resonant faces by a transfer matrix over its vertices, so that they are not
+// listed one by one
+class Structure_counter {
+public:
+  Structure_counter(const Fullerene(&F));
+  // the number of sets of num_faces independent faces, p of them pentagons,
+  // whose other vertices have a perfect matching, and the number of pairs of
+  // such a set and a perfect matching. Only the vertices with in_graph set
+  // are covered
+  void count(const vector<char>(&in_graph), const int p, const int num_faces,
+             long(&num_face_sets), long(&num_structures)) const;
+
+private:
+  template <int W>
+  void count_words(const vector<char>(&in_graph), const int p,
+                   const int num_faces, long(&num_face_sets),
+                   long(&num_structures)) const;
+
+  const Fullerene &F;
+  // the vertices in the order they are decided, and the position of each
+  vector<int> order, pos;
+  // first_faces[i] are the faces whose first vertex is order[i]
+  vector<vector<int>> first_faces;
+  // pents_after[i] is the number of pentagons decided at order[i] or later
+  vector<int> pents_after;
+};
+
+// Maximum matching of the subgraph of the primal graph induced by the vertices
+// that are not on a removed face. The matching is kept between calls, so after
+// a few faces are removed or added back only the vertices they exposed need to
+// be augmented from.
+class Matching {
+public:
+  Matching(const Fullerene(&F));
+  // take the vertices of face f out of the graph
+  void remove_face(const int f);
+  // put the vertices of face f back into the graph
+  void add_face(const int f);
+  // augment the matching, returns true if it covers every vertex in the graph
+  bool is_perfect();
+  // matching edges by edge id
+  void get_edges(Bitset(&match_e)) const;
+  // number of perfect matchings of the graph
+  long count_perfect(const Structure_counter(&counter)) const;
+
+private:
+  bool augment(const int root);
+  int lca(int a, int b);
+  void mark_path(int v, const int cur_base, int child);
+
+  const Fullerene &F;
+  vector<char> in_graph;
+  vector<int> mate, parent, base, queue;
+  vector<char> used, in_blossom, on_path;
+};
+
+// From native.cpp
+int native_anionic_clar(const Fullerene(&F), const int p,
+                        const vector<int>(&orbit), Clar_sol(&sol));
+int p_range_anionic_clar_native(const Fullerene(&F), const Options(&opts),
+                                const vector<int>(&bounds),
+                                vector<Out_ptrs>(&out_files_ptr),
+                                vector<int>(&clar_nums),
+                                vector<Clar_sol>(&sols));
+void clar_structures(const Fullerene(&F), const vector<int>(&p_vals),
+                     const vector<int>(&clar_nums), const bool list,
+                     vector<Clar_count>(&counts));
+
+// From bounds.cpp
+// bounds[k] is an upper bound on the p_vals[k]-anionic Clar number of F, or
+// -1 if F has no p_vals[k]-anionic resonance structure
+void clar_upper_bounds(const Fullerene(&F), const vector<int>(&p_vals),
+                       vector<int>(&bounds));
+void clar_upper_bounds(const Fullerene(&F), const vector<int>(&p_vals),
+                       vector<int>(&bounds), vector<string>(&certs));
+// the Lagrangian relaxation of the ILP for p rounded down, an upper bound on
+// the p-anionic Clar number pushed below bound if it can be, or -1 if it shows
+// there is no structure
+int lagrangian_bound(const Fullerene(&F), const int p, const int bound);
+void screen_bounds(const Fullerene(&F), const Options(&opts),
+                   vector<int>(&bounds), vector<string>(&certs));
+
+// From heuristic.cpp
+// a large p-anionic resonance structure found by greedy and local search, its
+// number of resonant faces is a lower bound on the p-anionic Clar number.
+// Returns -1 if no structure was found
+int heuristic_anionic_clar(const Fullerene(&F), const int p, Clar_sol(&sol));
+int p_range_anionic_clar_heuristic(const Fullerene(&F), const Options(&opts),
+                                   const vector<int>(&bounds),
+                                   vector<Out_ptrs>(&out_files_ptr),
+                                   vector<int>(&clar_nums),
+                                   vector<Clar_sol>(&sols));
+
+// From symmetry.cpp
+void automorphisms(const Fullerene(&F), vector<vector<int>>(&aut_faces));
+int face_through(const Fullerene(&F), const int a, const int b, const int c);
+int largest_face_orbit(const Fullerene(&F), vector<int>(&orbit));
+
+// From cache.cpp
+// canonical form of the embedding of an isomer, code is the same for every
+// labelling of the isomer and label[v] is the label of vertex v in it
+struct Canon {
+  vector<int> code, label;
+};
+void canonical_form(const Fullerene(&F), Canon(&canon));
+
+// Solutions of the isomers solved so far, keyed by p and the canonical form of
+// the isomer, kept in a file between runs. The Clar structures are stored in
+// canonical labels, so they can be mapped onto any labelling of the isomer.
+// Safe to use from several threads
+class Clar_cache {
+public:
+  // an empty name gives a cache that is never used
+  Clar_cache(const string name);
+  bool enabled() const { return !name.empty(); }
+  // returns false if the isomer has not been solved for p. sol is left empty
+  // if there is no structure
+  bool lookup(const Fullerene(&F), const Canon(&canon), const int p,
+              int(&num_res_faces), Clar_sol(&sol));
+  void store(const Fullerene(&F), const Canon(&canon), const int p,
+             const int num_res_faces, const Clar_sol(&sol));
+
+private:
+  struct Entry {
+    int num_res_faces;
+    // 3 consecutive vertices of each resonant face, and the endpoints of the
+    // matching edges
+    vector<int> faces, match;
+  };
+  bool parse_entry(const string(&line));
+  static string key(const int p, const vector<int>(&code));
+
+  const string name;
+  ofstream file;
+  mutex m;
+  unordered_map<string, Entry> entries;
+};
+
+// From stats.cpp
+// Reports on a run while it is in progress: a line on stderr every
+// opts.progress_secs seconds and a csv row of Isomer_stats per isomer
+class Stats_log {
+public:
+  // a run resumed at isomer first_id keeps the csv rows of those before it
+  Stats_log(const Options(&opts), const Input(&in), const int first_id);
+  // record an isomer once its rows have been written out
+  void add(const Fullerene(&F));
+  // the line for the whole run
+  void finish();
+
+private:
+  void report(const Clock::time_point now);
+
+  const int progress_secs;
+  Clock::time_point start, last_report;
+  long num_isomers, num_at_last_report;
+  // the part of the input the run reads, and how far it has got
+  size_t first_offset, end_offset, offset;
+  // the slowest isomers since the last report, as (time, id)
+  vector<pair<double, int>> slowest;
+  ofstream csv;
+};
+
+// From pipeline.cpp
+void prepare_isomer(Fullerene(&F), const Options(&opts));
+void solve_isomer(Fullerene(&F), const Options(&opts), GRBEnv(&grb_env),
+                  Clar_cache(&cache), vector<Out_ptrs>(&out_files_ptr),
+                  Run_stats(&stats));
+void solve_batch(vector<Fullerene>(&batch), const Options(&opts),
+                 GRBEnv(&grb_env), Clar_cache(&cache),
+                 vector<vector<Out_ptrs>>(&out_files_ptr), Run_stats(&stats));
+int run_pipeline(const Options(&opts), Input(&in), Out_files(&out),
+                 Clar_cache(&cache), Stats_log(&log), const int first_id,
+                 Run_stats(&stats));
+
+// From checkpoint.cpp
+void save_checkpoint(const Options(&opts), Out_files(&out), const int next_id,
+                     const size_t offset);
+bool load_checkpoint(const Options(&opts), int(&next_id), size_t(&offset));
+
+// From shard.cpp
+void shard_input(const Options(&opts), Input(&in), int(&first_id),
+                 int(&end_id));
+void save_shard_range(const Options(&opts), const int first_id,
+                      const int end_id);
+void merge_shards(const Options(&opts));
+void index_input(const Options(&opts), Input(&in));
+
+// From tune.cpp
+void load_params(const string name, vector<Grb_params>(&params));
+void tune_params(const Options(&opts), Input(&in));
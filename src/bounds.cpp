@@ -0,0 +1,258 @@
+#include "include.h"
+#include <algorithm>
+#include <cmath>
+
+// Upper bounds on the p-anionic Clar number by counting vertices. The resonant
+// faces are disjoint, so p pentagons and h hexagons cover 5p + 6h of the n
+// vertices and the rest are matched. Two faces share an edge or nothing, so a
+// pentagon that is not resonant has an even number of vertices on resonant
+// faces and at least one matched vertex. Hence
+//   h <= (n - 5p - m) / 6
+// where m is the fewest vertices (an even number) that meet every pentagon
+// that is not resonant. For p = 0 and isolated pentagons this is the bound
+// (n - 12) / 6 of Zhang and Ye. As n is even, there is no structure for odd
+// p, nor for p larger than the largest set of independent pentagons.
+// When there is no structure, certs gives the reason: odd for odd p,
+// pentagons if there are no p independent pentagons, and vertices if 5p and
+// the fewest vertices meeting the other pentagons are more than n
+void clar_upper_bounds(const Fullerene(&F), const vector<int>(&p_vals),
+                       vector<int>(&bounds), vector<string>(&certs)) {
+  const int num_pents = F.pents.size(), all = (1 << num_pents) - 1;
+  vector<int> pent_index(F.dual_n, -1);
+  for (int i = 0; i < num_pents; i++) {
+    pent_index[F.pents[i]] = i;
+  }
+  // the pentagons next to each pentagon, as bitmasks over the pentagons
+  vector<int> adj(num_pents, 0);
+  for (int i = 0; i < num_pents; i++) {
+    const face &pent = F.dual[F.pents[i]];
+    for (int k = 0; k < pent.size; k++) {
+      const int j = pent_index[pent.adj_f[k]];
+      if (j != -1)
+        adj[i] |= 1 << j;
+    }
+  }
+  // the pentagons each vertex lies on
+  vector<int> vertex_masks;
+  for (int v = 0; v < F.n; v++) {
+    int mask = 0;
+    for (int j = 0; j < 3; j++) {
+      const int i = pent_index[F.primal[v].faces[j]];
+      if (i != -1)
+        mask |= 1 << i;
+    }
+    if (mask)
+      vertex_masks.push_back(mask);
+  }
+  sort(vertex_masks.begin(), vertex_masks.end());
+  vertex_masks.erase(unique(vertex_masks.begin(), vertex_masks.end()),
+                     vertex_masks.end());
+
+  // cover[s] is the fewest vertices that meet every pentagon in s. First the
+  // fewest whose pentagons are exactly s, then the fewest over supersets of s
+  vector<int> cover(all + 1, F.n);
+  cover[0] = 0;
+  for (int s = 0; s <= all; s++) {
+    for (int mask : vertex_masks) {
+      cover[s | mask] = min(cover[s | mask], cover[s] + 1);
+    }
+  }
+  for (int i = 0; i < num_pents; i++) {
+    for (int s = 0; s <= all; s++) {
+      if (!(s & (1 << i)))
+        cover[s] = min(cover[s], cover[s | (1 << i)]);
+    }
+  }
+  // fewest matched vertices over the sets of c independent pentagons, F.n if
+  // there are none. A set is independent if it is without its lowest
+  // pentagon and that pentagon has no neighbour in it
+  vector<int> min_matched(num_pents + 1, F.n);
+  vector<char> indep(all + 1);
+  indep[0] = 1;
+  for (int s = 0; s <= all; s++) {
+    if (s) {
+      const int low = __builtin_ctz(s), rest = s & (s - 1);
+      indep[s] = indep[rest] && !(adj[low] & rest);
+    }
+    if (!indep[s])
+      continue;
+    const int c = __builtin_popcount(s);
+    int m = cover[all ^ s];
+    m += m & 1;
+    min_matched[c] = min(min_matched[c], m);
+  }
+
+  bounds.resize(p_vals.size());
+  certs.assign(p_vals.size(), "");
+  for (size_t k = 0; k < p_vals.size(); k++) {
+    const int p = p_vals[k];
+    bounds[k] = -1;
+    if (p % 2) {
+      certs[k] = "odd";
+    } else if (p > num_pents || min_matched[p] == F.n) {
+      certs[k] = "pentagons";
+    } else if (F.n - 5 * p - min_matched[p] < 0) {
+      certs[k] = "vertices";
+    } else {
+      bounds[k] = p + (F.n - 5 * p - min_matched[p]) / 6;
+    }
+  }
+}
+
+void clar_upper_bounds(const Fullerene(&F), const vector<int>(&p_vals),
+                       vector<int>(&bounds)) {
+  vector<string> certs;
+  clar_upper_bounds(F, p_vals, bounds, certs);
+}
+
+// steps of the subgradient method, and the steps without improvement after
+// which the step size is halved
+constexpr int LAGRANGE_STEPS = 300;
+constexpr int LAGRANGE_PATIENCE = 20;
+// slack on the value of the relaxation for rounding errors
+constexpr double LAGRANGE_EPS = 1e-6;
+
+// Lagrangian relaxation of the ILP for p. The rows covering each vertex once
+// get free multipliers lambda, and the rows that a pentagon that is not
+// resonant has a matched vertex (as in the counting bound) multipliers
+// mu >= 0. The relaxed problem then picks each hexagon and edge whose profit
+// is positive and the p pentagons of largest profit. Its value is an upper
+// bound for any multipliers, and the subgradient method lowers it below
+// bound, an integer at a time. Returns the lowest value found rounded down, -1 if it is below p and
+// there is no structure
+int lagrangian_bound(const Fullerene(&F), const int p, const int bound) {
+  const int num_pents = F.pents.size();
+  if (p > num_pents)
+    return -1;
+  vector<double> lambda(F.n, 1.0 / 6), mu(num_pents, 0), profit(F.dual_n);
+  vector<double> g_lambda(F.n), g_mu(num_pents), pent_profit(num_pents);
+  // the pentagons on each vertex
+  vector<vector<int>> vertex_pents(F.n);
+  for (int i = 0; i < num_pents; i++) {
+    const face &pent = F.dual[F.pents[i]];
+    for (int k = 0; k < 5; k++) {
+      vertex_pents[pent.vertices[k]].push_back(i);
+    }
+  }
+  vector<int> order(num_pents);
+  double best = F.dual_n, theta = 2;
+  int since_best = 0;
+  for (int step = 0; step < LAGRANGE_STEPS; step++) {
+    double value = 0;
+    for (int v = 0; v < F.n; v++) {
+      value += lambda[v];
+      g_lambda[v] = 1;
+    }
+    for (int i = 0; i < num_pents; i++) {
+      value -= mu[i];
+      g_mu[i] = -1;
+    }
+    // hexagons whose profit is positive
+    for (int f : F.hexes) {
+      double prof = 1;
+      for (int k = 0; k < 6; k++) {
+        prof -= lambda[F.dual[f].vertices[k]];
+      }
+      if (prof <= 0)
+        continue;
+      value += prof;
+      for (int k = 0; k < 6; k++) {
+        g_lambda[F.dual[f].vertices[k]]--;
+      }
+    }
+    // the p pentagons of largest profit
+    for (int i = 0; i < num_pents; i++) {
+      const face &pent = F.dual[F.pents[i]];
+      pent_profit[i] = 1 + mu[i];
+      for (int k = 0; k < 5; k++) {
+        pent_profit[i] -= lambda[pent.vertices[k]];
+      }
+      order[i] = i;
+    }
+    partial_sort(order.begin(), order.begin() + p, order.end(),
+                 [&](int a, int b) { return pent_profit[a] > pent_profit[b]; });
+    for (int j = 0; j < p; j++) {
+      const int i = order[j];
+      value += pent_profit[i];
+      g_mu[i]++;
+      for (int k = 0; k < 5; k++) {
+        g_lambda[F.dual[F.pents[i]].vertices[k]]--;
+      }
+    }
+    // edges whose profit is positive, a matched vertex meets its pentagons
+    for (int e = 0; e < F.num_edges; e++) {
+      const int u = F.edges[e].vertices[0], w = F.edges[e].vertices[1];
+      double prof = -lambda[u] - lambda[w];
+      for (int i : vertex_pents[u]) {
+        prof += mu[i];
+      }
+      for (int i : vertex_pents[w]) {
+        prof += mu[i];
+      }
+      if (prof <= 0)
+        continue;
+      value += prof;
+      g_lambda[u]--;
+      g_lambda[w]--;
+      for (int i : vertex_pents[u]) {
+        g_mu[i]++;
+      }
+      for (int i : vertex_pents[w]) {
+        g_mu[i]++;
+      }
+    }
+    if (value < best - 1e-9) {
+      best = value;
+      since_best = 0;
+    } else if (++since_best == LAGRANGE_PATIENCE) {
+      theta /= 2;
+      since_best = 0;
+    }
+    // stop once there is no structure
+    if (best < p - LAGRANGE_EPS)
+      break;
+    // step towards half an integer below the bound so far (Polyak's rule),
+    // the multipliers on the pentagon rows stay non-negative
+    double norm = 0;
+    for (int v = 0; v < F.n; v++) {
+      norm += g_lambda[v] * g_lambda[v];
+    }
+    for (int i = 0; i < num_pents; i++) {
+      if (mu[i] > 0 || g_mu[i] < 0)
+        norm += g_mu[i] * g_mu[i];
+    }
+    if (norm == 0)
+      break;
+    const double target = min(bound, (int)floor(best + LAGRANGE_EPS)) - 0.5;
+    const double t = theta * (value - target) / norm;
+    for (int v = 0; v < F.n; v++) {
+      lambda[v] -= t * g_lambda[v];
+    }
+    for (int i = 0; i < num_pents; i++) {
+      mu[i] = max(0.0, mu[i] - t * g_mu[i]);
+    }
+  }
+  if (best < p - LAGRANGE_EPS)
+    return -1;
+  return (int)floor(best + LAGRANGE_EPS);
+}
+
+// The bounds the engines solve against for each value of p in opts. With
+// --screen the counting bounds are tightened by the Lagrangian relaxation,
+// whose certificate is relaxation when it shows there is no structure
+void screen_bounds(const Fullerene(&F), const Options(&opts),
+                   vector<int>(&bounds), vector<string>(&certs)) {
+  clar_upper_bounds(F, opts.p_vals, bounds, certs);
+  if (!opts.screen)
+    return;
+  Clock::time_point timer = Clock::now();
+  for (size_t k = 0; k < opts.p_vals.size(); k++) {
+    if (bounds[k] == -1)
+      continue;
+    const int relaxed = lagrangian_bound(F, opts.p_vals[k], bounds[k]);
+    if (relaxed == -1)
+      certs[k] = "relaxation";
+    bounds[k] = min(bounds[k], relaxed);
+  }
+  F.stats.build_us += lap_us(timer);
+}
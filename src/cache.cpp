@@ -0,0 +1,217 @@
+#include "include.h"
+#include <algorithm>
+#include <sstream>
+
+// Number the vertices breadth first from the flag (v, r, dir): v gets label 0
+// and the neighbours of each vertex are visited in the order of the rotation
+// system (reversed if dir is 2), starting from the one it was reached from,
+// or from position r for v. The code lists the labels of the neighbours of
+// each vertex in the order the vertices were labelled. Stops as soon as the
+// code is larger than best and returns true if it is smaller
+bool flag_code(const Fullerene(&F), const int v, const int r, const int dir,
+               const vector<int>(&best), Canon(&cur), vector<int>(&rot),
+               vector<int>(&order)) {
+  vector<int> &label = cur.label, &code = cur.code;
+  fill(label.begin(), label.end(), -1);
+  label[v] = 0;
+  rot[v] = r;
+  order[0] = v;
+  int num_labelled = 1, c = 0;
+  bool smaller = best.empty();
+  for (int head = 0; head < F.n; head++) {
+    const int x = order[head];
+    for (int i = 0; i < 3; i++) {
+      const int pos = (rot[x] + dir * i) % 3, u = F.primal[x].adj_v[pos];
+      if (label[u] == -1) {
+        label[u] = num_labelled;
+        order[num_labelled++] = u;
+        // the neighbours of u are visited starting from x
+        rot[u] = F.primal[x].ports[pos];
+      }
+      code[c] = label[u];
+      if (!smaller) {
+        if (code[c] > best[c])
+          return false;
+        smaller = code[c] < best[c];
+      }
+      c++;
+    }
+  }
+  return smaller;
+}
+
+void canonical_form(const Fullerene(&F), Canon(&canon)) {
+  // the code is the smallest over the flags at the vertices on the most
+  // pentagons, which do not depend on how the vertices were labelled, nor on
+  // the orientation of the embedding. The 12 pentagons have at most 60
+  // vertices, so this is at most 360 walks of O(n) each, rather than 6n
+  vector<int> num_pents(F.n, 0);
+  int most_pents = 0;
+  for (int v = 0; v < F.n; v++) {
+    for (int j = 0; j < 3; j++) {
+      num_pents[v] += F.pent_mask[F.primal[v].faces[j]];
+    }
+    most_pents = max(most_pents, num_pents[v]);
+  }
+  Canon cur;
+  cur.label.resize(F.n);
+  cur.code.resize(3 * F.n);
+  vector<int> rot(F.n), order(F.n);
+  canon.code.clear();
+  for (int v = 0; v < F.n; v++) {
+    if (num_pents[v] != most_pents)
+      continue;
+    for (int r = 0; r < 3; r++) {
+      for (int dir = 1; dir <= 2; dir++) {
+        if (flag_code(F, v, r, dir, canon.code, cur, rot, order))
+          canon = cur;
+      }
+    }
+  }
+}
+
+Clar_cache::Clar_cache(const string name) : name(name) {
+  if (name.empty())
+    return;
+  ifstream in(name);
+  string line;
+  int line_num = 0;
+  bool ends_in_newline = true;
+  while (getline(in, line)) {
+    line_num++;
+    ends_in_newline = !in.eof();
+    if (!parse_entry(line) && ends_in_newline) {
+      throw runtime_error("\nError: Invalid entry on line " +
+                          to_string(line_num) + " of cache " + name);
+    }
+  }
+  in.close();
+  // an interrupted run may have left half an entry, which was skipped
+  file.open(name, ios::app);
+  if (!file.is_open()) {
+    throw runtime_error("\nError: Could not open file " + name);
+  }
+  if (!ends_in_newline)
+    file << endl;
+}
+
+// a line of the cache holds p, n and the canonical code, which make up the
+// key, then the p-anionic Clar number, the number of resonant faces followed
+// by 3 consecutive vertices of each and the number of matching edges
+// followed by their endpoints, all in canonical labels
+bool Clar_cache::parse_entry(const string(&line)) {
+  istringstream in(line);
+  int p, n, num_faces, num_match;
+  Entry entry;
+  if (!(in >> p >> n) || n < 20 || n > 100000)
+    return false;
+  vector<int> code(3 * n);
+  for (int &c : code) {
+    in >> c;
+  }
+  in >> entry.num_res_faces >> num_faces;
+  if (!in || num_faces < 0 || num_faces > n)
+    return false;
+  entry.faces.resize(3 * num_faces);
+  for (int &v : entry.faces) {
+    in >> v;
+  }
+  in >> num_match;
+  if (!in || num_match < 0 || num_match > n)
+    return false;
+  entry.match.resize(2 * num_match);
+  for (int &v : entry.match) {
+    in >> v;
+  }
+  if (!in)
+    return false;
+  entries[key(p, code)] = entry;
+  return true;
+}
+
+string Clar_cache::key(const int p, const vector<int>(&code)) {
+  string k = to_string(p) + " " + to_string(code.size() / 3);
+  for (int c : code) {
+    k += " " + to_string(c);
+  }
+  return k;
+}
+
+bool Clar_cache::lookup(const Fullerene(&F), const Canon(&canon), const int p,
+                        int(&num_res_faces), Clar_sol(&sol)) {
+  Entry entry;
+  {
+    lock_guard<mutex> lock(m);
+    auto it = entries.find(key(p, canon.code));
+    if (it == entries.end())
+      return false;
+    entry = it->second;
+  }
+  // map the canonical labels back to the vertices of F
+  vector<int> vertex_of(F.n);
+  for (int v = 0; v < F.n; v++) {
+    vertex_of[canon.label[v]] = v;
+  }
+  num_res_faces = entry.num_res_faces;
+  sol.res_face.clear();
+  sol.match_e.clear();
+  // with no resonance structure there is nothing to map, as for a solve
+  if (entry.faces.empty() && entry.match.empty())
+    return true;
+  sol.res_face.assign(F.dual_n);
+  sol.match_e.assign(F.num_edges);
+  for (size_t i = 0; i < entry.faces.size(); i += 3) {
+    const int f = face_through(F, vertex_of[entry.faces[i]],
+                               vertex_of[entry.faces[i + 1]],
+                               vertex_of[entry.faces[i + 2]]);
+    sol.res_face.set(f);
+  }
+  for (size_t i = 0; i < entry.match.size(); i += 2) {
+    const int u = vertex_of[entry.match[i]], w = vertex_of[entry.match[i + 1]];
+    int j = 0;
+    while (j < 3 && F.primal[u].adj_v[j] != w)
+      j++;
+    if (j == 3) {
+      throw_error(F.n, p, F.id,
+                  "\nCached matching edge is not an edge of the isomer");
+    }
+    sol.match_e.set(F.primal[u].edges[j]);
+  }
+  return true;
+}
+
+void Clar_cache::store(const Fullerene(&F), const Canon(&canon), const int p,
+                       const int num_res_faces, const Clar_sol(&sol)) {
+  Entry entry;
+  entry.num_res_faces = num_res_faces;
+  // with no resonance structure there is nothing to certify. A structure
+  // without resonant faces (p = 0) still has its matching
+  if (!sol.match_e.empty()) {
+    for (int f = 0; f < F.dual_n; f++) {
+      if (!sol.res_face[f])
+        continue;
+      for (int k = 0; k < 3; k++) {
+        entry.faces.push_back(canon.label[F.dual[f].vertices[k]]);
+      }
+    }
+    for (int e = 0; e < F.num_edges; e++) {
+      if (!sol.match_e[e])
+        continue;
+      entry.match.push_back(canon.label[F.edges[e].vertices[0]]);
+      entry.match.push_back(canon.label[F.edges[e].vertices[1]]);
+    }
+  }
+  const string k = key(p, canon.code);
+  lock_guard<mutex> lock(m);
+  if (!entries.insert(make_pair(k, entry)).second)
+    return;
+  file << k << " " << num_res_faces << " " << entry.faces.size() / 3;
+  for (int v : entry.faces) {
+    file << " " << v;
+  }
+  file << " " << entry.match.size() / 2;
+  for (int v : entry.match) {
+    file << " " << v;
+  }
+  file << endl;
+}
@@ -0,0 +1,79 @@
+#include "include.h"
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+string checkpoint_name(const Options(&opts)) {
+  string name = "output/pp_checkpoint" + shard_suffix(opts);
+  get_out_name(opts.p_vals[0], name);
+  return name;
+}
+
+// make sure what was written to file name has reached the disk
+void sync_file(const string name) {
+  const int fd = open(name.c_str(), O_RDONLY);
+  if (fd < 0 || fsync(fd) != 0) {
+    throw runtime_error("\nError: Could not sync file " + name);
+  }
+  close(fd);
+}
+
+// Record that every isomer before next_id has been written to the out files,
+// and that the isomer next_id starts at byte offset of the input. The sizes of
+// the out files are recorded with it, so that rows written after the
+// checkpoint can be dropped on resume. The checkpoint is written to a
+// temporary file and renamed over the old one, so a crash leaves either the
+// old or the new checkpoint
+void save_checkpoint(const Options(&opts), Out_files(&out), const int next_id,
+                     const size_t offset) {
+  const string name = checkpoint_name(opts), tmp_name = name + ".tmp";
+  ofstream tmp(tmp_name, ios::trunc);
+  if (!tmp.is_open()) {
+    throw runtime_error("\nError: Could not open file " + tmp_name);
+  }
+  tmp << next_id << " " << offset << endl;
+  for (size_t k = 0; k < out.files.size(); k++) {
+    for (int i = 0; i < NFILE; i++) {
+      const string &out_name = out.names[k][i];
+      if (out_name.empty())
+        continue;
+      out.files[k][i].flush();
+      sync_file(out_name);
+      struct stat st;
+      if (stat(out_name.c_str(), &st) != 0) {
+        throw runtime_error("\nError: Could not stat file " + out_name);
+      }
+      tmp << out_name << " " << st.st_size << endl;
+    }
+  }
+  tmp.close();
+  if (!tmp) {
+    throw runtime_error("\nError: Could not write file " + tmp_name);
+  }
+  sync_file(tmp_name);
+  if (rename(tmp_name.c_str(), name.c_str()) != 0) {
+    throw runtime_error("\nError: Could not rename " + tmp_name + " to " +
+                        name);
+  }
+}
+
+// Read the checkpoint of a previous run and truncate its out files to where
+// the checkpoint was taken. Returns false if there is no checkpoint
+bool load_checkpoint(const Options(&opts), int(&next_id), size_t(&offset)) {
+  const string name = checkpoint_name(opts);
+  ifstream file(name);
+  if (!file.is_open())
+    return false;
+  if (!(file >> next_id >> offset)) {
+    throw runtime_error("\nError: Invalid checkpoint " + name);
+  }
+  string out_name;
+  off_t size;
+  while (file >> out_name >> size) {
+    if (truncate(out_name.c_str(), size) != 0) {
+      throw runtime_error("\nError: Could not truncate file " + out_name);
+    }
+  }
+  return true;
+}
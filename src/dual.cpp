@@ -1,52 +1,73 @@
 #include "include.h"
 #include <stdexcept>
 
-int find_position(const int v, const int u, int v_adj[3]) {
-#if DEBUG_DUAL
-  cout << "Looking for neighbour " << u << " of vertex " << v << endl;
-#endif
-  for (int i = 0; i < 3; i++) {
-    if (v_adj[i] == u)
-      return i;
+// the position after each position in an adj list, modulo 3
+constexpr int NEXT_POS[3] = {1, 2, 0};
+
+// Find, for the jth neighbour u of each vertex v, the position of v in u's adj
+// list. With these ports the faces and edges are walked without searching
+// the adjacency lists again
+void find_ports(Fullerene(&F), const int p) {
+  // through a plain pointer, so that the compiler need not reload F.n after
+  // every store
+  vertex *primal = F.primal.data();
+  for (int v = 0; v < F.n; v++) {
+    for (int j = 0; j < 3; j++) {
+      const int u = primal[v].adj_v[j];
+      if ((unsigned)u >= (unsigned)F.n) {
+        throw_error(F.n, p, F.id,
+                    "\nVertex " + to_string(v) + " has invalid neighbour " +
+                        to_string(u));
+      }
+      const int *u_adj = primal[u].adj_v;
+      // malformed input may list v more than once, or not at all
+      int pos = 0, num_found = 0;
+      for (int i = 0; i < 3; i++) {
+        if (u_adj[i] == v) {
+          pos = i;
+          num_found++;
+        }
+      }
+      if (num_found != 1) {
+        throw_error(F.n, p, F.id,
+                    "\nVertex " + to_string(v) + " appears " +
+                        to_string(num_found) + " times in neighbourhood of "
+                        "vertex " + to_string(u));
+      }
+      primal[v].ports[j] = pos;
+    }
   }
-  throw runtime_error("\nCould not find position of vertex " + to_string(u) +
-                      " in neighbourhood of vertex " + to_string(v));
 }
 
-int counter_clockwise_walk(const int face_id, int u, int v, const int n,
+int counter_clockwise_walk(const int face_id, int u, int pos,
                            vector<vertex>(&primal), face(&cur_face)) {
-  // find the position of v in u's adj list, remember this list is in clockwise
-  // order in a planar embedding
-  int pos = find_position(u, v, primal[u].adj_v);
-  // initialize the face size
+  // pos is the position in u's adj list of the next vertex on the face,
+  // remember this list is in clockwise order in a planar embedding
   int face_size = 0;
-  // w will be used to walk around the face
-  int w;
+  vertex *V = primal.data();
 
   // while there exists a vertex on the face that has not recorded the face id
-  while (primal[u].faces[pos] == -1) {
+  while (V[u].faces[pos] == -1) {
+    if (face_size == 6) {
+      throw runtime_error("\nError: face " + to_string(face_id) +
+                          " has more than 6 vertices");
+    }
     // record u as a vertex of face we are walking the boundary of counter
     // clockwise
-    cur_face.vertices[face_size++] = u;
+    cur_face.vertices[face_size] = u;
+    // until the faces are all known, the adjacent face slot keeps the
+    // position of the edge in u's adj list
+    cur_face.adj_f[face_size++] = pos;
     // record the face id for vertex u, note the position is unique identified
     // by v's position in u's adj list
-    primal[u].faces[pos] = face_id;
-    // we want to grab the next vertex on the face during our counter clockwise
-    // walk, first we grab the position of u in v's adj list.
-    try {
-      pos = find_position(v, u, primal[v].adj_v);
-    } catch (runtime_error e) {
-      throw runtime_error(e);
-    }
-    // move to the next position (modulo 3) in v's adj list to get the next
-    // vertex
-    pos = (pos + 1) % 3;
-    // record w as this next vertex
-    w = primal[v].adj_v[pos];
+    V[u].faces[pos] = face_id;
+    // the next vertex on the face follows u (modulo 3) in v's adj list, the
+    // port gives u's position there
+    const int v = V[u].adj_v[pos];
+    pos = NEXT_POS[V[u].ports[pos]];
     // shift along vertices and repeat loop
     u = v;
-    v = w;
-    // this will terminate once v becomes the original u handed to the function
+    // this will terminate once u is back at the vertex handed to the function
   }
   // lets check that face is pentagon or hexagon
   if (face_size != 5 && face_size != 6) {
@@ -59,6 +80,42 @@ int counter_clockwise_walk(const int face_id, int u, int v, const int n,
   return face_size;
 }
 
+// add the mask of vertex v to the masks of a face or edge, whose masks
+// start at first
+void add_vertex(Vertex_masks(&masks), const int first, const int v) {
+  const uint64_t bit = uint64_t(1) << (v & 63);
+  for (size_t j = first; j < masks.word.size(); j++) {
+    if (masks.word[j] == v >> 6) {
+      masks.bits[j] |= bit;
+      return;
+    }
+  }
+  masks.word.push_back(v >> 6);
+  masks.bits.push_back(bit);
+}
+
+// the vertices of each face and then each edge as masks over the words of the
+// vertices, the vectors keep their capacity between isomers
+void vertex_masks(Fullerene(&F)) {
+  Vertex_masks &masks = F.masks;
+  masks.start.clear();
+  masks.word.clear();
+  masks.bits.clear();
+  for (int f = 0; f < F.dual_n; f++) {
+    masks.start.push_back(masks.word.size());
+    for (int k = 0; k < F.dual[f].size; k++) {
+      add_vertex(masks, masks.start.back(), F.dual[f].vertices[k]);
+    }
+  }
+  for (int e = 0; e < F.num_edges; e++) {
+    masks.start.push_back(masks.word.size());
+    for (int k = 0; k < 2; k++) {
+      add_vertex(masks, masks.start.back(), F.edges[e].vertices[k]);
+    }
+  }
+  masks.start.push_back(masks.word.size());
+}
+
 void construct_planar_dual(Fullerene(&F), const int p) {
   // When we read in the fullerene, we had not yet assigned face ids. Therefore,
   // we set the face ids at each vertex as -1 (to represent unassigned). We
@@ -68,6 +125,7 @@ void construct_planar_dual(Fullerene(&F), const int p) {
   cout << "Constructing planar dual" << endl;
 #endif
 
+  find_ports(F, p);
   int face_id = 0, edge_id = 0, u;
   // for each vertex v
   for (int v = 0; v < F.n; v++) {
@@ -79,12 +137,7 @@ void construct_planar_dual(Fullerene(&F), const int p) {
       if (v < u) {
         // u is the jth neighbour of v
         F.primal[v].edges[j] = edge_id;
-        // find position of v in u's neighbourhood
-        try {
-          F.primal[u].edges[find_position(u, v, F.primal[u].adj_v)] = edge_id;
-        } catch (runtime_error e) {
-          throw_error(F.n, p, F.id, e.what());
-        }
+        F.primal[u].edges[F.primal[v].ports[j]] = edge_id;
         // record vertices of given edge
         F.edges[edge_id].vertices[0] = v;
         F.edges[edge_id].vertices[1] = u;
@@ -92,10 +145,12 @@ void construct_planar_dual(Fullerene(&F), const int p) {
       }
       // if face is unassigned
       if (F.primal[v].faces[j] == -1) {
+        if (face_id == (int)F.dual.size())
+          throw_error(F.n, p, F.id, "\nToo many faces for a fullerene");
         // lets walk the face containing u and v
         try {
-          F.dual[face_id].size = counter_clockwise_walk(
-              face_id, v, u, F.n, F.primal, F.dual[face_id]);
+          F.dual[face_id].size = counter_clockwise_walk(face_id, v, j, F.primal,
+                                                        F.dual[face_id]);
         } catch (runtime_error e) {
           throw_error(F.n, p, F.id, e.what());
         }
@@ -110,26 +165,33 @@ void construct_planar_dual(Fullerene(&F), const int p) {
   F.num_edges = edge_id;
   // record the number of faces in the planar dual
   F.dual_n = face_id;
+  // split the faces by size, the vectors keep their capacity between isomers
+  F.pents.clear();
+  F.hexes.clear();
+  F.pent_mask.assign(face_id);
+  for (int f = 0; f < face_id; f++) {
+    if (F.dual[f].size == 5) {
+      F.pents.push_back(f);
+      F.pent_mask.set(f);
+    } else {
+      F.hexes.push_back(f);
+    }
+  }
 
   // by this point, we have determined which vertices and in which face by face
   // id we now want to determine the adjacency between faces in the planar dual
-  int v, face_g, face_f_size, pos;
+  int v, face_g, pos;
   // for each face f
   for (int f = 0; f < face_id; f++) {
-    face_f_size = F.dual[f].size;
     // for each vertex on face i
-    for (int j = 0; j < face_f_size; j++) {
-      // uv is an edge on face i
+    for (int j = 0; j < F.dual[f].size; j++) {
+      // uv is an edge on face i, at position pos in u's adj list
       u = F.dual[f].vertices[j];
-      v = F.dual[f].vertices[(j + 1) % face_f_size];
-      // get the position of u in v's adj list
-      try {
-        pos = find_position(v, u, F.primal[v].adj_v);
-      } catch (runtime_error e) {
-        throw_error(F.n, p, F.id, e.what());
-      }
-      // face_g is the face that v and u lie on that is not equal to face f
-      face_g = F.primal[v].faces[pos];
+      pos = F.dual[f].adj_f[j];
+      v = F.primal[u].adj_v[pos];
+      // face_g is the face that v and u lie on that is not equal to face f,
+      // the port gives the position of u in v's adj list
+      face_g = F.primal[v].faces[F.primal[u].ports[pos]];
       // update adj list of face f
       F.dual[f].adj_f[j] = face_g;
 #if DEBUG_DUAL
@@ -141,4 +203,5 @@ void construct_planar_dual(Fullerene(&F), const int p) {
 #if DEBUG_DUAL
   cout << endl;
 #endif
+  vertex_masks(F);
 }
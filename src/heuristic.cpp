@@ -0,0 +1,192 @@
+#include "include.h"
+#include <algorithm>
+#include <random>
+
+// number of greedy orders tried, the first is by face id
+constexpr int NUM_STARTS = 4;
+
+// Greedy and local search for a large p-anionic resonance structure. Faces
+// are made resonant one at a time as long as the remaining vertices keep a
+// perfect matching, which the Matching repairs after each change. Pentagons
+// go in pairs, a single one would leave an odd number of vertices. The
+// structure is then improved by swapping a resonant hexagon for two of its
+// neighbours. Each greedy order gives a structure, the largest is kept.
+class Clar_heuristic {
+public:
+  Clar_heuristic(const Fullerene(&F))
+      : F(F), matching(F), resonant(F.dual_n, 0), covered(F.n, 0),
+        pents(F.pents), hexes(F.hexes), rng(F.n) {}
+
+  // returns the number of resonant faces of the structure found and the
+  // structure in sol, or -1 if no p-anionic resonance structure was found
+  int run(const int p, Clar_sol(&sol)) {
+    int best = -1;
+    for (int start = 0; start < NUM_STARTS && p % 2 == 0; start++) {
+      if (start > 0) {
+        shuffle(pents.begin(), pents.end(), rng);
+        shuffle(hexes.begin(), hexes.end(), rng);
+      }
+      if (add_pents(p)) {
+        fill_hexes();
+        while (swap_hexes())
+          fill_hexes();
+        if ((int)chosen.size() > best) {
+          best = chosen.size();
+          sol.res_face.assign(F.dual_n);
+          for (int f : chosen) {
+            sol.res_face.set(f);
+          }
+          matching.is_perfect();
+          matching.get_edges(sol.match_e);
+        }
+      }
+      // leave every face out for the next order
+      while (!chosen.empty())
+        remove(chosen.back());
+    }
+    if (best == -1) {
+      sol.res_face.clear();
+      sol.match_e.clear();
+    }
+    return best;
+  }
+
+private:
+  // make p pentagons resonant, two at a time
+  bool add_pents(const int p) {
+    for (int num_pents = 0; num_pents < p; num_pents += 2) {
+      bool added = false;
+      for (size_t i = 0; i < pents.size() && !added; i++) {
+        for (size_t j = i + 1; j < pents.size() && !added; j++) {
+          added = try_add(pents[i], pents[j]);
+        }
+      }
+      if (!added)
+        return false;
+    }
+    return true;
+  }
+
+  void fill_hexes() {
+    for (int h : hexes) {
+      try_add(h, -1);
+    }
+  }
+
+  // replace a resonant hexagon by two or more of its neighbours, returns true
+  // if a swap was made
+  bool swap_hexes() {
+    const vector<int> cur = chosen;
+    for (int h : cur) {
+      if (F.dual[h].size != 6)
+        continue;
+      remove(h);
+      vector<int> added;
+      for (int k = 0; k < 6; k++) {
+        const int g = F.dual[h].adj_f[k];
+        if (F.dual[g].size == 6 && try_add(g, -1))
+          added.push_back(g);
+      }
+      if (added.size() >= 2)
+        return true;
+      for (int g : added) {
+        remove(g);
+      }
+      try_add(h, -1);
+    }
+    return false;
+  }
+
+  bool is_available(const int f) const {
+    for (int k = 0; k < F.dual[f].size; k++) {
+      if (covered[F.dual[f].vertices[k]])
+        return false;
+    }
+    return true;
+  }
+
+  // make f (and g, unless it is -1) resonant if they are available, do not
+  // share a vertex and the remaining vertices still have a perfect matching
+  bool try_add(const int f, const int g) {
+    if (!is_available(f))
+      return false;
+    set_face(f, 1);
+    if (g != -1 && !is_available(g)) {
+      set_face(f, 0);
+      return false;
+    }
+    matching.remove_face(f);
+    if (g != -1) {
+      set_face(g, 1);
+      matching.remove_face(g);
+    }
+    if (matching.is_perfect()) {
+      chosen.push_back(f);
+      if (g != -1)
+        chosen.push_back(g);
+      return true;
+    }
+    set_face(f, 0);
+    matching.add_face(f);
+    if (g != -1) {
+      set_face(g, 0);
+      matching.add_face(g);
+    }
+    return false;
+  }
+
+  void remove(const int f) {
+    set_face(f, 0);
+    matching.add_face(f);
+    chosen.erase(find(chosen.begin(), chosen.end(), f));
+  }
+
+  void set_face(const int f, const char state) {
+    resonant[f] = state;
+    for (int k = 0; k < F.dual[f].size; k++) {
+      covered[F.dual[f].vertices[k]] = state;
+    }
+  }
+
+  const Fullerene &F;
+  Matching matching;
+  vector<char> resonant, covered;
+  vector<int> chosen, pents, hexes;
+  mt19937 rng;
+};
+
+int heuristic_anionic_clar(const Fullerene(&F), const int p,
+                           Clar_sol(&sol)) {
+  Clar_heuristic heur(F);
+  return heur.run(p, sol);
+}
+
+// returns the number of values of p whose structure meets the upper bound,
+// those are Clar structures
+int p_range_anionic_clar_heuristic(const Fullerene(&F), const Options(&opts),
+                                   const vector<int>(&bounds),
+                                   vector<Out_ptrs>(&out_files_ptr),
+                                   vector<int>(&clar_nums),
+                                   vector<Clar_sol>(&sols)) {
+  const vector<int> &p_vals = opts.p_vals;
+  int num_by_bound = 0;
+  for (size_t k = 0; k < p_vals.size(); k++) {
+    const int p = p_vals[k];
+    Clock::time_point timer = Clock::now();
+    int num_res_faces =
+        bounds[k] == -1 ? -1 : heuristic_anionic_clar(F, p, sols[k]);
+    F.stats.optimize_us += lap_us(timer);
+    num_by_bound += num_res_faces == bounds[k];
+    if (num_res_faces == -1) {
+      // no structure was found
+      sols[k].res_face.clear();
+      sols[k].match_e.clear();
+      num_res_faces = 0;
+    } else {
+      num_res_faces = check_if_sol_valid(F, p, sols[k]);
+    }
+    write_sol(F, opts, p, num_res_faces, sols[k], out_files_ptr[k].data());
+    clar_nums[k] = num_res_faces;
+  }
+  return num_by_bound;
+}
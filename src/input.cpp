@@ -0,0 +1,235 @@
+#include "include.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// size of the read buffer when the input can not be memory mapped (a pipe)
+constexpr size_t BUFFER_SIZE = 1 << 20;
+// no integer we read is longer than this, refill before parsing if closer to
+// the end of the buffer
+constexpr ptrdiff_t MAX_TOKEN = 32;
+
+Input::Input(const int fd)
+    : fd(fd), mapped(false), eof(false), map(nullptr), map_size(0),
+      cur(nullptr), end(nullptr), base(0) {
+  struct stat st;
+  // regular files are mapped as a whole and parsed in place
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED) {
+      madvise(addr, st.st_size, MADV_SEQUENTIAL);
+      map = (char *)addr;
+      map_size = st.st_size;
+      mapped = eof = true;
+      cur = map;
+      end = map + map_size;
+    }
+  }
+  if (!mapped) {
+    buffer.resize(BUFFER_SIZE);
+    cur = end = buffer.data();
+  }
+  detect_format();
+}
+
+// buckygen and plantri start binary planar_code output with a header of the
+// form >>planar_code<<, which may give the byte order, e.g. >>planar_code le<<
+void Input::detect_format() {
+  fmt = ADJ_LIST;
+  big_endian = false;
+  if (end - cur < MAX_TOKEN && !eof)
+    refill();
+  const string magic = ">>planar_code";
+  if (end - cur < (ptrdiff_t)magic.size() ||
+      memcmp(cur, magic.data(), magic.size()) != 0)
+    return;
+  const char *close = cur + magic.size();
+  while (close + 1 < end && !(close[0] == '<' && close[1] == '<'))
+    close++;
+  if (close + 1 >= end)
+    throw runtime_error("\nError: Unterminated planar_code header");
+  const string order(cur + magic.size(), close);
+  if (order == " be") {
+    big_endian = true;
+  } else if (!order.empty() && order != " le") {
+    throw runtime_error("\nError: Unknown planar_code byte order" + order);
+  }
+  fmt = PLANAR_CODE;
+  cur = close + 2;
+}
+
+Input::~Input() {
+  if (mapped)
+    munmap(map, map_size);
+}
+
+// move the unread bytes to the front of the buffer and read until there are
+// enough bytes for a token. A pipe is not waited on any longer than that, so
+// the isomers are parsed as soon as they come in
+void Input::refill() {
+  const size_t left = end - cur;
+  base += cur - buffer.data();
+  memmove(buffer.data(), cur, left);
+  cur = buffer.data();
+  char *dest = buffer.data() + left;
+  while (!eof && dest - cur < MAX_TOKEN) {
+    const ssize_t got = read(fd, dest, buffer.data() + buffer.size() - dest);
+    if (got < 0) {
+      if (errno == EINTR)
+        continue;
+      throw runtime_error("\nError: Could not read input: " +
+                          string(strerror(errno)));
+    }
+    if (got == 0)
+      eof = true;
+    dest += got;
+  }
+  end = dest;
+}
+
+void Input::skip_space() {
+  while (true) {
+    if (end - cur < MAX_TOKEN && !eof)
+      refill();
+    while (cur < end && (*cur == ' ' || *cur == '\n' || *cur == '\t' ||
+                         *cur == '\r'))
+      cur++;
+    if (cur < end || eof)
+      break;
+  }
+}
+
+bool Input::next_int(int(&x)) {
+  skip_space();
+  if (end - cur < MAX_TOKEN && !eof)
+    refill();
+  if (cur == end)
+    return false;
+  bool negative = false;
+  const char *start = cur;
+  if (*cur == '-' || *cur == '+') {
+    negative = *cur == '-';
+    cur++;
+  }
+  // parse the digits, the value is accumulated in an unsigned so that it can
+  // not overflow
+  unsigned value = 0;
+  const char *digits = cur;
+  while (cur < end && (unsigned)(*cur - '0') < 10) {
+    value = 10 * value + (*cur - '0');
+    cur++;
+  }
+  if (cur == digits) {
+    // not an integer, leave the input where it was
+    cur = start;
+    return false;
+  }
+  x = negative ? -(int)value : (int)value;
+  return true;
+}
+
+bool Input::next_entry(unsigned(&x), const bool wide) {
+  const ptrdiff_t len = wide ? 2 : 1;
+  if (end - cur < MAX_TOKEN && !eof)
+    refill();
+  if (end - cur < len)
+    return false;
+  const unsigned char *bytes = (const unsigned char *)cur;
+  if (!wide) {
+    x = bytes[0];
+  } else if (big_endian) {
+    x = (bytes[0] << 8) | bytes[1];
+  } else {
+    x = bytes[0] | (bytes[1] << 8);
+  }
+  cur += len;
+  return true;
+}
+
+size_t Input::offset() const {
+  return base + (cur - (mapped ? map : buffer.data()));
+}
+
+void Input::seek(const size_t off) {
+  if (mapped) {
+    if (off > map_size) {
+      throw runtime_error("\nError: Offset " + to_string(off) +
+                          " is past the end of the input");
+    }
+    cur = map + off;
+    return;
+  }
+  // a pipe can only be read forward, the bytes before off are discarded
+  if (off < offset())
+    throw runtime_error("\nError: Can not seek backwards in a pipe");
+  while (offset() < off) {
+    if (cur == end && eof) {
+      throw runtime_error("\nError: Offset " + to_string(off) +
+                          " is past the end of the input");
+    }
+    if (cur == end)
+      refill();
+    cur += min((size_t)(end - cur), off - offset());
+  }
+}
+
+bool Input::skip_isomer() {
+  if (fmt == PLANAR_CODE) {
+    unsigned n, entry;
+    if (!next_entry(n, false))
+      return false;
+    // a first byte of 0 marks 2 byte entries, the first of them being n
+    const bool wide = n == 0;
+    if (wide && !next_entry(n, true))
+      return false;
+    // skip the zero terminated neighbour list of each vertex
+    for (unsigned i = 0; i < n; i += entry == 0) {
+      if (!next_entry(entry, wide))
+        return false;
+    }
+  } else {
+    int n, val;
+    if (!next_int(n))
+      return false;
+    // skip the degree and three neighbours of each vertex
+    for (int i = 0; i < 4 * n; i++) {
+      if (!next_int(val))
+        return false;
+    }
+  }
+  return true;
+}
+
+void Input::limit(const size_t off) {
+  if (!mapped)
+    throw runtime_error("\nError: Can only limit input read from a file");
+  if (off > map_size) {
+    throw runtime_error("\nError: Offset " + to_string(off) +
+                        " is past the end of the input");
+  }
+  end = map + off;
+}
+
+vector<size_t> Input::index_isomers() {
+  if (!mapped)
+    throw runtime_error("\nError: Can only index input read from a file");
+  vector<size_t> offsets;
+  const char *start = cur;
+  while (true) {
+    if (fmt == ADJ_LIST)
+      skip_space();
+    const size_t off = offset();
+    if (cur == end)
+      break;
+    if (!skip_isomer()) {
+      throw runtime_error("\nError: Could not read the isomer at offset " +
+                          to_string(off));
+    }
+    offsets.push_back(off);
+  }
+  cur = start;
+  return offsets;
+}
@@ -1,62 +1,146 @@
 #include "include.h"
+#include <algorithm>
+#include <climits>
+#include <memory>
 
-int check_if_sol_valid(const Fullerene(&F), const int p,
-                       const vector<GRBVar> fvars, const vector<GRBVar> evars) {
-  int num_res_faces = 0, res_pents = 0;
-  // for each vertex in the graph
-  for (int i = 0; i < F.n; i++) {
-    // they should be covered by the p-anionic Clar structure exactly once
-    int covered = 0;
-    for (int j = 0; j < 3; j++) {
-      // note the tolerance given to the variable assignment, i.e. > 0.99
-      // covered by matching edge
-      if (evars[F.primal[i].edges[j]].get(GRB_DoubleAttr_X) > 0.99)
-        covered++;
-      // covered by resonant face
-      if (fvars[F.primal[i].faces[j]].get(GRB_DoubleAttr_X) > 0.99)
-        covered++;
-    }
-    if (covered != 1) {
-      const string msg = "\nVertex " + to_string(i) + " is covered " +
-                         to_string(covered) + " times by structure.";
+// the number of times vertex i is covered by the structure, for reporting
+int num_covers(const Fullerene(&F), const Clar_sol(&sol), const int i) {
+  int covered = 0;
+  for (int j = 0; j < 3; j++) {
+    covered += sol.match_e[F.primal[i].edges[j]];
+    covered += sol.res_face[F.primal[i].faces[j]];
+  }
+  return covered;
+}
+
+// Check the structures of a batch of isomers for p, sols[i] is that of
+// batch[i], and return their numbers of resonant faces in num_res_faces.
+// Every vertex should be covered by its p-anionic Clar structure exactly
+// once. The vertices of the batch are laid out one isomer after another in
+// words, and each matching edge and resonant face ORs its vertex masks into
+// covered, and what they already covered into twice. One pass over the words
+// then finds a vertex covered twice or not at all. The words are kept
+// between calls on a thread, so that the structures of a run are checked
+// without allocating
+void check_sols_valid(const vector<const Fullerene *>(&batch), const int p,
+                      const vector<const Clar_sol *>(&sols),
+                      vector<int>(&num_res_faces)) {
+  thread_local vector<uint64_t> covered, twice;
+  thread_local vector<int> first_word;
+  const int num_isomers = batch.size();
+  first_word.assign(1, 0);
+  for (int i = 0; i < num_isomers; i++) {
+    first_word.push_back(first_word.back() + (batch[i]->n + 63) / 64);
+  }
+  covered.assign(first_word.back(), 0);
+  twice.assign(first_word.back(), 0);
+  for (int i = 0; i < num_isomers; i++) {
+    const Fullerene &F = *batch[i];
+    const Vertex_masks &masks = F.masks;
+    uint64_t *cov = covered.data() + first_word[i];
+    uint64_t *tw = twice.data() + first_word[i];
+    auto cover = [&](const int x) {
+      for (int j = masks.start[x]; j < masks.start[x + 1]; j++) {
+        tw[masks.word[j]] |= cov[masks.word[j]] & masks.bits[j];
+        cov[masks.word[j]] |= masks.bits[j];
+      }
+    };
+    sols[i]->res_face.for_each(cover);
+    sols[i]->match_e.for_each([&](const int e) { cover(F.dual_n + e); });
+  }
+  num_res_faces.resize(num_isomers);
+  for (int i = 0; i < num_isomers; i++) {
+    const Fullerene &F = *batch[i];
+    for (int w = first_word[i]; w < first_word[i + 1]; w++) {
+      // the bits past the last vertex are never covered
+      const int num_bits = min(64, F.n - 64 * (w - first_word[i]));
+      const uint64_t all = num_bits == 64 ? ~uint64_t(0)
+                                          : (uint64_t(1) << num_bits) - 1;
+      const uint64_t wrong = twice[w] | (covered[w] ^ all);
+      if (wrong) {
+        const int v = 64 * (w - first_word[i]) + __builtin_ctzll(wrong);
+        const string msg = "\nVertex " + to_string(v) + " is covered " +
+                           to_string(num_covers(F, *sols[i], v)) +
+                           " times by structure.";
+        throw_error(F.n, p, F.id, msg);
+      }
+    }
+    const int res_pents = sols[i]->res_face.count_and(F.pent_mask);
+    if (res_pents != p) {
+      const string msg =
+          "\nIncorrect # of res. pents: " + to_string(res_pents);
       throw_error(F.n, p, F.id, msg);
     }
+    num_res_faces[i] = sols[i]->res_face.count();
   }
-  // for each face in graph
+}
+
+int check_if_sol_valid(const Fullerene(&F), const int p,
+                       const Clar_sol(&sol)) {
+  thread_local vector<const Fullerene *> batch(1);
+  thread_local vector<const Clar_sol *> sols(1);
+  thread_local vector<int> num_res_faces;
+  batch[0] = &F;
+  sols[0] = &sol;
+  check_sols_valid(batch, p, sols, num_res_faces);
+  return num_res_faces[0];
+}
+
+// the structure given by the values of the face and edge variables
+void x_to_sol(const Fullerene(&F), const double *fx, const double *ex,
+              Clar_sol(&sol)) {
+  sol.res_face.assign(F.dual_n);
+  sol.match_e.assign(F.num_edges);
+  // note the tolerance given to the variable assignment, i.e. > 0.99
   for (int i = 0; i < F.dual_n; i++) {
-    if (fvars[i].get(GRB_DoubleAttr_X) > 0.99) {
-      num_res_faces++;
-      if (F.dual[i].size == 5)
-        res_pents += 1;
-    }
+    if (fx[i] > 0.99)
+      sol.res_face.set(i);
   }
-  if (res_pents != p) {
-    const string msg = "\nIncorrect # of res. pents: " + to_string(res_pents);
-    throw_error(F.n, p, F.id, msg);
+  for (int i = 0; i < F.num_edges; i++) {
+    if (ex[i] > 0.99)
+      sol.match_e.set(i);
   }
-  return num_res_faces;
 }
 
-int assess_solve(const Fullerene(&F), const int p, GRBModel(&model),
-                 vector<GRBVar>(&fvars), vector<GRBVar>(&evars),
-                 ofstream out_files_ptr[NFILE]) {
+// the values of the variables are fetched in one call for the faces and one
+// for the edges, rather than one call per variable
+void get_sol(const Fullerene(&F), GRBModel(&model),
+             const vector<GRBVar>(&fvars), const vector<GRBVar>(&evars),
+             Clar_sol(&sol)) {
+  double *fx = model.get(GRB_DoubleAttr_X, fvars.data(), F.dual_n);
+  double *ex = model.get(GRB_DoubleAttr_X, evars.data(), F.num_edges);
+  x_to_sol(F, fx, ex, sol);
+  delete[] fx;
+  delete[] ex;
+}
 
+int assess_solve(const Fullerene(&F), const Options(&opts), const int p,
+                 GRBModel(&model),
+                 vector<GRBVar>(&fvars), vector<GRBVar>(&evars),
+                 ostream *out_files_ptr[NFILE], Clar_sol(&sol)) {
+  sol.res_face.clear();
+  sol.match_e.clear();
   int optimstatus = model.get(GRB_IntAttr_Status);
-  // if optimum is attained
-  if (optimstatus == GRB_OPTIMAL) {
+  // the variables are binary, so presolve's infeasible or unbounded means
+  // infeasible
+  if (optimstatus == GRB_INF_OR_UNBD)
+    optimstatus = GRB_INFEASIBLE;
+  // if optimum is attained, or a solution that meets the upper bound
+  if (optimstatus == GRB_OPTIMAL || optimstatus == GRB_USER_OBJ_LIMIT) {
     // check solution and grab number of resonant faces
-    int num_res_faces = check_if_sol_valid(F, p, fvars, evars);
-    save_sol(F, p, num_res_faces, fvars, evars, out_files_ptr);
+    get_sol(F, model, fvars, evars, sol);
+    int num_res_faces = check_if_sol_valid(F, p, sol);
+    write_sol(F, opts, p, num_res_faces, sol, out_files_ptr);
 #if DEBUG_CLAR
-    print_sol(F, num_res_faces, fvars, evars);
+    print_sol(F, num_res_faces, sol);
 #endif
     return num_res_faces;
     // if there is no solution
   } else if (optimstatus == GRB_INFEASIBLE) {
     // there are 0 resonant faces since no valid solution
-    save_sol(F, p, 0, fvars, evars, out_files_ptr);
+    write_sol(F, opts, p, 0, sol, out_files_ptr);
 #if DEBUG_CLAR
-    print_sol(F, 0, fvars, evars);
+    print_sol(F, 0, sol);
 #endif
     return 0;
   } else {
@@ -67,8 +151,91 @@ int assess_solve(const Fullerene(&F), const int p, GRBModel(&model),
   }
 }
 
-void add_cons(const Fullerene(&F), const int p, GRBModel(&model),
-              vector<GRBVar>(&fvars), vector<GRBVar>(&evars)) {
+// Heuristic callback. At each node the face variables of the LP relaxation
+// are rounded to a set of independent faces with p pentagons. If the matching
+// oracle finds a perfect matching on the remaining vertices, the structure is
+// handed to Gurobi as a new incumbent. Lazy constraints are not needed since
+// the ILP already asks for the matching edges.
+class Matching_callback : public GRBCallback {
+public:
+  Matching_callback(const Fullerene(&F), vector<GRBVar>(&fvars),
+                    vector<GRBVar>(&evars))
+      : p(0), F(F), fvars(fvars), evars(evars), matching(F),
+        removed(F.dual_n, 0), chosen(F.dual_n), used(F.n), order(F.dual_n),
+        fvals(F.dual_n), evals(F.num_edges) {}
+  // current value of p
+  int p;
+
+protected:
+  void callback() {
+    if (where != GRB_CB_MIPNODE ||
+        getIntInfo(GRB_CB_MIPNODE_STATUS) != GRB_OPTIMAL)
+      return;
+    double *y = getNodeRel(fvars.data(), F.dual_n);
+    for (int f = 0; f < F.dual_n; f++) {
+      order[f] = f;
+    }
+    sort(order.begin(), order.end(),
+         [&](const int a, const int b) { return y[a] > y[b]; });
+    // take exactly p pentagons and the hexagons that are more than half
+    // resonant, in order of their value in the relaxation
+    fill(used.begin(), used.end(), 0);
+    int num_pents = 0;
+    for (int f : order) {
+      const bool is_pent = F.dual[f].size == 5;
+      chosen[f] = 0;
+      if ((is_pent && num_pents == p) || (!is_pent && y[f] <= 0.5))
+        continue;
+      bool free = true;
+      for (int k = 0; k < F.dual[f].size; k++) {
+        free = free && !used[F.dual[f].vertices[k]];
+      }
+      if (!free)
+        continue;
+      chosen[f] = 1;
+      num_pents += is_pent;
+      for (int k = 0; k < F.dual[f].size; k++) {
+        used[F.dual[f].vertices[k]] = 1;
+      }
+    }
+    delete[] y;
+    if (num_pents != p)
+      return;
+    // only the faces that changed since the last call touch the matching
+    for (int f = 0; f < F.dual_n; f++) {
+      if (removed[f] && !chosen[f])
+        matching.add_face(f);
+    }
+    for (int f = 0; f < F.dual_n; f++) {
+      if (!removed[f] && chosen[f])
+        matching.remove_face(f);
+      removed[f] = chosen[f];
+    }
+    if (!matching.is_perfect())
+      return;
+    matching.get_edges(match_e);
+    for (int f = 0; f < F.dual_n; f++) {
+      fvals[f] = chosen[f];
+    }
+    for (int i = 0; i < F.num_edges; i++) {
+      evals[i] = match_e[i];
+    }
+    setSolution(fvars.data(), fvals.data(), F.dual_n);
+    setSolution(evars.data(), evals.data(), F.num_edges);
+  }
+
+private:
+  const Fullerene &F;
+  vector<GRBVar> &fvars, &evars;
+  Matching matching;
+  vector<char> removed, chosen, used;
+  Bitset match_e;
+  vector<int> order;
+  vector<double> fvals, evals;
+};
+
+GRBConstr add_cons(const Fullerene(&F), const int p, GRBModel(&model),
+                   vector<GRBVar>(&fvars), vector<GRBVar>(&evars)) {
   // each vertex is either in a resonant face or is the endpoint of
   // a matching edge
   for (int i = 0; i < F.n; i++) {
@@ -86,12 +253,45 @@ void add_cons(const Fullerene(&F), const int p, GRBModel(&model),
 
   // need p resonant pentagons
   GRBLinExpr cons2 = 0;
-  for (int f = 0; f < F.dual_n; f++) {
-    if (F.dual[f].size == 5)
-      cons2 += fvars[f];
+  for (int f : F.pents) {
+    cons2 += fvars[f];
+  }
+  // add constraint to model, it is returned so that the value of p can be
+  // changed without rebuilding the model
+  return model.addConstr(cons2 == p);
+}
+
+// Symmetric copies of a solution are all feasible, so the ILP would search each
+// of them. A solution with a resonant face in an orbit of the automorphism
+// group has a copy in which the first face of the orbit is resonant, so only
+// those are kept. The largest orbit rules out the most copies
+void add_symmetry_cons(const Fullerene(&F), GRBModel(&model),
+                       vector<GRBVar>(&fvars)) {
+  vector<int> orbit;
+  if (largest_face_orbit(F, orbit) < 2)
+    return;
+  for (size_t i = 1; i < orbit.size(); i++) {
+    model.addConstr(fvars[orbit[i]] <= fvars[orbit[0]]);
+  }
+}
+
+// give the structure in sol to Gurobi as a MIP start, or clear the start
+// left by the previous value of p if there is none
+void set_start(const Fullerene(&F), const bool has_start, const Clar_sol(&sol),
+               GRBModel(&model), vector<GRBVar>(&fvars),
+               vector<GRBVar>(&evars)) {
+  vector<double> fstart(F.dual_n, GRB_UNDEFINED),
+      estart(F.num_edges, GRB_UNDEFINED);
+  if (has_start) {
+    for (int f = 0; f < F.dual_n; f++) {
+      fstart[f] = sol.res_face[f];
+    }
+    for (int i = 0; i < F.num_edges; i++) {
+      estart[i] = sol.match_e[i];
+    }
   }
-  // add constraint to model
-  model.addConstr(cons2 == p);
+  model.set(GRB_DoubleAttr_Start, fvars.data(), fstart.data(), F.dual_n);
+  model.set(GRB_DoubleAttr_Start, evars.data(), estart.data(), F.num_edges);
 }
 
 void add_vars(const Fullerene(&F), const int p, GRBModel(&model),
@@ -109,8 +309,15 @@ void add_vars(const Fullerene(&F), const int p, GRBModel(&model),
   }
 }
 
-int p_anionic_clar_lp(const Fullerene(&F), const int p, GRBEnv grb_env,
-                      ofstream out_files_ptr[NFILE]) {
+// returns the number of values of p settled by the upper bounds
+int p_range_anionic_clar_lp(const Fullerene(&F), const Options(&opts),
+                            const vector<int>(&bounds), GRBEnv(&grb_env),
+                            vector<Out_ptrs>(&out_files_ptr),
+                            vector<int>(&clar_nums), vector<Clar_sol>(&sols)) {
+  const vector<int> &p_vals = opts.p_vals;
+  // the current value of p, for error reporting
+  int p = p_vals[0], num_by_bound = 0;
+  Clock::time_point timer = Clock::now();
 #if DEBUG_CLAR
   cout << "n = " << F.n << ", p = " << p << ", graph num = " << F.id << endl;
   cout << "Solving LP" << endl;
@@ -133,13 +340,71 @@ int p_anionic_clar_lp(const Fullerene(&F), const int p, GRBEnv grb_env,
     add_vars(F, p, model, fvars, evars);
 
     // add constraints to model
-    add_cons(F, p, model, fvars, evars);
+    GRBConstr pent_cons = add_cons(F, p, model, fvars, evars);
+    if (opts.symmetry)
+      add_symmetry_cons(F, model, fvars);
+    // the upper bound on the objective, set for each value of p
+    GRBLinExpr obj = 0;
+    for (int f = 0; f < F.dual_n; f++) {
+      obj += fvars[f];
+    }
+    GRBConstr bound_cons = model.addConstr(obj <= F.dual_n);
 
-    // The objective coefficients are set during the creation of
-    // the decision variables above. Run model
-    model.optimize();
-    // assess the solve
-    return assess_solve(F, p, model, fvars, evars, out_files_ptr);
+    // complete the node relaxations into solutions with the matching oracle,
+    // which is only built when asked for
+    unique_ptr<Matching_callback> match_cb;
+    if (opts.match_heuristic) {
+      match_cb = make_unique<Matching_callback>(F, fvars, evars);
+      model.setCallback(match_cb.get());
+    }
+    F.stats.build_us += lap_us(timer);
+
+    // The model is only built once, for each value of p we update the number
+    // of resonant pentagons required and let Gurobi reuse what it can from the
+    // previous solve
+    for (size_t k = 0; k < p_vals.size(); k++) {
+      p = p_vals[k];
+      if (bounds[k] == -1) {
+        // there is no structure to look for, e.g. for odd p
+        sols[k].res_face.clear();
+        sols[k].match_e.clear();
+        write_sol(F, opts, p, 0, sols[k], out_files_ptr[k].data());
+        clar_nums[k] = 0;
+        num_by_bound++;
+        continue;
+      }
+      // the structure found by the heuristic is optimal if it meets the
+      // bound, otherwise it is the incumbent Gurobi starts from
+      timer = Clock::now();
+      const int start = heuristic_anionic_clar(F, p, sols[k]);
+      if (start == bounds[k]) {
+        F.stats.optimize_us += lap_us(timer);
+        clar_nums[k] = check_if_sol_valid(F, p, sols[k]);
+        write_sol(F, opts, p, clar_nums[k], sols[k], out_files_ptr[k].data());
+        num_by_bound++;
+        continue;
+      }
+      set_start(F, start != -1, sols[k], model, fvars, evars);
+      pent_cons.set(GRB_DoubleAttr_RHS, p);
+      bound_cons.set(GRB_DoubleAttr_RHS, bounds[k]);
+      // a solution that meets the bound is optimal, there is nothing left to
+      // prove (the objective is integral)
+      model.set(GRB_DoubleParam_BestObjStop, bounds[k] - 0.5);
+      set_params(model, find_params(opts, F.n, p));
+      if (match_cb)
+        match_cb->p = p;
+      // The objective coefficients are set during the creation of
+      // the decision variables above. Run model
+      model.optimize();
+      F.stats.optimize_us += lap_us(timer);
+      F.stats.nodes += model.get(GRB_DoubleAttr_NodeCount);
+      F.stats.grb_runtime_us += 1e6 * model.get(GRB_DoubleAttr_Runtime);
+      F.stats.grb_work += model.get(GRB_DoubleAttr_Work);
+      num_by_bound += model.get(GRB_IntAttr_Status) == GRB_USER_OBJ_LIMIT;
+      // assess the solve
+      clar_nums[k] = assess_solve(F, opts, p, model, fvars, evars,
+                                  out_files_ptr[k].data(), sols[k]);
+    }
 
   } catch (GRBException e) {
     const string msg = "\nCode: " + to_string(e.getErrorCode()) +
@@ -150,5 +415,227 @@ int p_anionic_clar_lp(const Fullerene(&F), const int p, GRBEnv grb_env,
   } catch (...) {
     throw_error(F.n, p, F.id, "\nUnknown error during optimization");
   }
-  return -1;
+  return num_by_bound;
+}
+
+// switch the block of an isomer in a batch on (p resonant pentagons) or off
+// (its faces fixed to 0, leaving a perfect matching which always exists)
+void set_block(const Fullerene(&F), const bool on, const int p,
+               GRBModel(&model), const vector<GRBVar>(&fvars),
+               GRBConstr(&pent_cons)) {
+  const vector<double> ub(F.dual_n, on ? 1.0 : 0.0);
+  model.set(GRB_DoubleAttr_UB, fvars.data(), ub.data(), F.dual_n);
+  pent_cons.set(GRB_DoubleAttr_RHS, on ? p : 0);
+}
+
+// Solve a batch of isomers as disjoint blocks of one model. The objective is
+// the sum of theirs, so an optimal solution is optimal on every block, and
+// the cost of building, solving and reading a model is paid once per batch.
+// An isomer settled by its bound or by the heuristic has its block switched
+// off for that value of p. If the batch is infeasible, each of its isomers is
+// solved on its own. Returns the number of solves settled by the bounds
+int batch_anionic_clar_lp(const vector<const Fullerene *>(&batch),
+                          const Options(&opts),
+                          const vector<vector<int>>(&bounds), GRBEnv(&grb_env),
+                          vector<vector<Out_ptrs>>(&out_files_ptr),
+                          vector<vector<int>>(&clar_nums),
+                          vector<vector<Clar_sol>>(&sols)) {
+  const vector<int> &p_vals = opts.p_vals;
+  const int num_isomers = batch.size(), num_p = p_vals.size();
+  clar_nums.assign(num_isomers, vector<int>(num_p));
+  sols.assign(num_isomers, vector<Clar_sol>(num_p));
+  // the current value of p and isomer, for error reporting
+  int p = p_vals[0], num_by_bound = 0;
+  const Fullerene *G = batch[0];
+  // the model is built and solved for the whole batch, its isomers share the
+  // time evenly
+  Clock::time_point timer = Clock::now();
+  try {
+    GRBModel model = GRBModel(grb_env);
+    model.set(GRB_IntAttr_ModelSense, GRB_MAXIMIZE);
+    model.set(GRB_IntParam_IntegralityFocus, 1);
+    vector<vector<GRBVar>> fvars(num_isomers), evars(num_isomers);
+    vector<GRBConstr> pent_cons(num_isomers);
+    // the variables of every block, the faces then the edges of each isomer
+    // from offset[i] on, so that the solution is fetched in one call
+    vector<GRBVar> all_vars;
+    vector<int> offset(num_isomers);
+    // the batch is solved with the parameters of its largest isomer
+    int max_n = 0;
+    for (int i = 0; i < num_isomers; i++) {
+      G = batch[i];
+      max_n = max(max_n, G->n);
+      fvars[i].resize(G->dual_n);
+      evars[i].resize(G->num_edges);
+      add_vars(*G, p, model, fvars[i], evars[i]);
+      pent_cons[i] = add_cons(*G, p, model, fvars[i], evars[i]);
+      if (opts.symmetry)
+        add_symmetry_cons(*G, model, fvars[i]);
+      offset[i] = all_vars.size();
+      all_vars.insert(all_vars.end(), fvars[i].begin(), fvars[i].end());
+      all_vars.insert(all_vars.end(), evars[i].begin(), evars[i].end());
+    }
+    const double build_us = lap_us(timer) / num_isomers;
+    for (int i = 0; i < num_isomers; i++) {
+      batch[i]->stats.build_us += build_us;
+    }
+
+    vector<char> active(num_isomers);
+    for (int k = 0; k < num_p; k++) {
+      p = p_vals[k];
+      // the isomers that are not settled by their bound or the heuristic are
+      // solved, and the batch is done once it meets the sum of their bounds
+      int num_active = 0, target = 0;
+      timer = Clock::now();
+      for (int i = 0; i < num_isomers; i++) {
+        G = batch[i];
+        Clar_sol &sol = sols[i][k];
+        const int start =
+            bounds[i][k] == -1 ? -1 : heuristic_anionic_clar(*G, p, sol);
+        active[i] = bounds[i][k] != -1 && start != bounds[i][k];
+        set_block(*G, active[i], p, model, fvars[i], pent_cons[i]);
+        set_start(*G, active[i] && start != -1, sol, model, fvars[i],
+                  evars[i]);
+        if (active[i]) {
+          num_active++;
+          target += bounds[i][k];
+        } else {
+          clar_nums[i][k] = start == -1 ? 0 : check_if_sol_valid(*G, p, sol);
+          num_by_bound++;
+        }
+        G->stats.optimize_us += lap_us(timer);
+      }
+      G = batch[0];
+      int status = GRB_OPTIMAL;
+      if (num_active > 0) {
+        model.set(GRB_DoubleParam_BestObjStop, target - 0.5);
+        set_params(model, find_params(opts, max_n, p));
+        model.optimize();
+        status = model.get(GRB_IntAttr_Status);
+        // the variables are binary, so presolve's infeasible or unbounded
+        // means infeasible
+        if (status == GRB_INF_OR_UNBD)
+          status = GRB_INFEASIBLE;
+        const double optimize_us = lap_us(timer) / num_active;
+        const double nodes = model.get(GRB_DoubleAttr_NodeCount) / num_active;
+        const double runtime_us =
+            1e6 * model.get(GRB_DoubleAttr_Runtime) / num_active;
+        const double work = model.get(GRB_DoubleAttr_Work) / num_active;
+        for (int i = 0; i < num_isomers; i++) {
+          if (!active[i])
+            continue;
+          batch[i]->stats.optimize_us += optimize_us;
+          batch[i]->stats.nodes += nodes;
+          batch[i]->stats.grb_runtime_us += runtime_us;
+          batch[i]->stats.grb_work += work;
+        }
+      }
+
+      if (num_active > 0 &&
+          (status == GRB_OPTIMAL || status == GRB_USER_OBJ_LIMIT)) {
+        // no block is above its bound, so meeting their sum meets each one
+        if (status == GRB_USER_OBJ_LIMIT)
+          num_by_bound += num_active;
+        double *x = model.get(GRB_DoubleAttr_X, all_vars.data(),
+                              all_vars.size());
+        vector<const Fullerene *> solved;
+        vector<const Clar_sol *> solved_sols;
+        for (int i = 0; i < num_isomers; i++) {
+          G = batch[i];
+          if (!active[i])
+            continue;
+          const double *fx = x + offset[i], *ex = fx + G->dual_n;
+          x_to_sol(*G, fx, ex, sols[i][k]);
+          solved.push_back(G);
+          solved_sols.push_back(&sols[i][k]);
+        }
+        delete[] x;
+        vector<int> solved_nums;
+        check_sols_valid(solved, p, solved_sols, solved_nums);
+        for (int i = 0, j = 0; i < num_isomers; i++) {
+          if (active[i])
+            clar_nums[i][k] = solved_nums[j++];
+        }
+      } else if (status == GRB_INFEASIBLE) {
+        // some isomer of the batch has no structure
+        Options single_opts = opts;
+        single_opts.p_vals.assign(1, p);
+        for (int i = 0; i < num_isomers; i++) {
+          if (!active[i])
+            continue;
+          vector<Out_ptrs> single_ptrs(1, out_files_ptr[i][k]);
+          const vector<int> single_bounds(1, bounds[i][k]);
+          vector<int> single_nums(1);
+          vector<Clar_sol> single_sols(1);
+          num_by_bound += p_range_anionic_clar_lp(
+              *batch[i], single_opts, single_bounds, grb_env, single_ptrs,
+              single_nums, single_sols);
+          clar_nums[i][k] = single_nums[0];
+          sols[i][k] = move(single_sols[0]);
+        }
+      } else if (status != GRB_OPTIMAL) {
+        const string msg = "\nStatus of batch solve: " + to_string(status) +
+                           "\nCheck Gurobi Optimization Status Codes";
+        throw_error(G->n, p, G->id, msg);
+      }
+      // the isomers solved on their own have written their solutions
+      for (int i = 0; i < num_isomers; i++) {
+        if (status == GRB_INFEASIBLE && active[i])
+          continue;
+        write_sol(*batch[i], opts, p, clar_nums[i][k], sols[i][k],
+                  out_files_ptr[i][k].data());
+      }
+    }
+
+  } catch (const GRBException &e) {
+    const string msg = "\nCode: " + to_string(e.getErrorCode()) +
+                       "\nMessage: " + e.getMessage();
+    throw_error(G->n, p, G->id, msg);
+  } catch (runtime_error e) {
+    throw runtime_error(e);
+  } catch (...) {
+    throw_error(G->n, p, G->id, "\nUnknown error during optimization");
+  }
+  return num_by_bound;
+}
+
+int p_anionic_clar_lp(const Fullerene(&F), const int p, GRBEnv(&grb_env),
+                      ostream *out_files_ptr[NFILE]) {
+  Options opts;
+  opts.p_vals.assign(1, p);
+  vector<Out_ptrs> out_ptrs(1);
+  copy(out_files_ptr, out_files_ptr + NFILE, out_ptrs[0].begin());
+  vector<int> bounds, clar_nums(1);
+  vector<Clar_sol> sols(1);
+  clar_upper_bounds(F, opts.p_vals, bounds);
+  p_range_anionic_clar_lp(F, opts, bounds, grb_env, out_ptrs, clar_nums, sols);
+  return clar_nums[0];
+}
+
+// The parameters tuned for isomers of n vertices and p: those of the bucket of
+// sizes holding n, else those of the nearest bucket tuned for p, else the
+// defaults
+const Grb_params &find_params(const Options(&opts), const int n, const int p) {
+  static const Grb_params defaults;
+  const Grb_params *best = &defaults;
+  int best_dist = INT_MAX;
+  for (const Grb_params &params : opts.params) {
+    if (params.p != p)
+      continue;
+    const int dist = n < params.n_first  ? params.n_first - n
+                     : n > params.n_last ? n - params.n_last
+                                         : 0;
+    if (dist < best_dist) {
+      best = &params;
+      best_dist = dist;
+    }
+  }
+  return *best;
+}
+
+// https://www.gurobi.com/documentation/11.0/refman/parameters.html
+void set_params(GRBModel(&model), const Grb_params(&params)) {
+  model.set(GRB_IntParam_Presolve, params.presolve);
+  model.set(GRB_IntParam_Cuts, params.cuts);
+  model.set(GRB_IntParam_MIPFocus, params.mip_focus);
 }
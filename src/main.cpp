@@ -1,37 +1,260 @@
 #include "include.h"
+#include <sstream>
+#include <unistd.h>
 
-int main(int argc, char *argv[]) {
+void usage_error(const string message) {
+  throw runtime_error("\nError: " + message +
+                      "\nUsage: comp_anionic_clar_num {p} [options]"
+                      "\n       comp_anionic_clar_num --p-range first:last:step"
+                      " [options]");
+}
+
+// parse a range of p values given as first:last:step
+void parse_p_range(const string arg, vector<int>(&p_vals)) {
+  int first, last, step;
+  char sep1, sep2;
+  istringstream range(arg);
+  if (!(range >> first >> sep1 >> last >> sep2 >> step) || sep1 != ':' ||
+      sep2 != ':' || step < 1 || first > last) {
+    usage_error("invalid range of p " + arg);
+  }
+  p_vals.clear();
+  for (int p = first; p <= last; p += step) {
+    p_vals.push_back(p);
+  }
+}
+
+// parse a shard given as i/k, the ith of k shards counting from 0
+void parse_shard(const string arg, Options(&opts)) {
+  char sep;
+  istringstream shard(arg);
+  if (!(shard >> opts.shard >> sep >> opts.num_shards) || sep != '/' ||
+      opts.shard < 0 || opts.shard >= opts.num_shards) {
+    usage_error("invalid shard " + arg);
+  }
+}
+
+// isomers between checkpoints if resuming without --checkpoint
+constexpr int DEFAULT_CHECKPOINT = 1000;
+
+Options parse_args(int argc, char *argv[]) {
+  Options opts;
+  int i = 1;
   // want to solve for the p-anionic Clar number
-  int p = atoi(argv[1]);
-  // isomer
+  if (i < argc && string(argv[i]).compare(0, 2, "--") != 0) {
+    opts.p_vals.push_back(atoi(argv[i++]));
+  }
+  for (; i < argc; i++) {
+    const string arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc) {
+      opts.num_threads = atoi(argv[++i]);
+      if (opts.num_threads < 1)
+        usage_error("--threads must be at least 1");
+    } else if (arg == "--batch" && i + 1 < argc) {
+      opts.batch_size = atoi(argv[++i]);
+      if (opts.batch_size < 1)
+        usage_error("--batch must be at least 1");
+    } else if (arg == "--p-range" && i + 1 < argc) {
+      parse_p_range(argv[++i], opts.p_vals);
+    } else if (arg == "--binary-out") {
+      opts.binary_out = true;
+    } else if (arg == "--bin-to-text" && i + 1 < argc) {
+      opts.bin_to_text = argv[++i];
+    } else if (arg == "--count-structures") {
+      opts.count_structures = true;
+    } else if (arg == "--list-structures") {
+      opts.count_structures = opts.list_structures = true;
+    } else if (arg == "--progress" && i + 1 < argc) {
+      opts.progress_secs = atoi(argv[++i]);
+      if (opts.progress_secs < 1)
+        usage_error("--progress must be at least 1");
+    } else if (arg == "--stats" && i + 1 < argc) {
+      opts.stats_file = argv[++i];
+    } else if (arg == "--tune" && i + 1 < argc) {
+      opts.tune_file = argv[++i];
+    } else if (arg == "--tune-samples" && i + 1 < argc) {
+      opts.tune_samples = atoi(argv[++i]);
+      if (opts.tune_samples < 1)
+        usage_error("--tune-samples must be at least 1");
+    } else if (arg == "--params" && i + 1 < argc) {
+      load_params(argv[++i], opts.params);
+    } else if (arg == "--screen") {
+      opts.screen = true;
+    } else if (arg == "--stdout") {
+      opts.to_stdout = true;
+    } else if (arg == "--shard" && i + 1 < argc) {
+      parse_shard(argv[++i], opts);
+    } else if (arg == "--index" && i + 1 < argc) {
+      opts.index_file = argv[++i];
+    } else if (arg == "--merge" && i + 1 < argc) {
+      opts.merge_shards = atoi(argv[++i]);
+      if (opts.merge_shards < 1)
+        usage_error("--merge must be at least 1");
+    } else if (arg == "--checkpoint" && i + 1 < argc) {
+      opts.checkpoint_every = atoi(argv[++i]);
+      if (opts.checkpoint_every < 1)
+        usage_error("--checkpoint must be at least 1");
+    } else if (arg == "--resume") {
+      opts.resume = true;
+    } else if (arg == "--cache" && i + 1 < argc) {
+      opts.cache_file = argv[++i];
+    } else if (arg == "--heuristic-only") {
+      opts.heuristic_only = true;
+    } else if (arg == "--symmetry") {
+      opts.symmetry = true;
+    } else if (arg == "--match-heuristic") {
+      opts.match_heuristic = true;
+    } else if (arg == "--engine" && i + 1 < argc) {
+      const string engine = argv[++i];
+      if (engine == "gurobi") {
+        opts.engine = GUROBI;
+      } else if (engine == "native") {
+        opts.engine = NATIVE;
+      } else {
+        usage_error("unknown engine " + engine);
+      }
+    } else {
+      usage_error("unknown argument " + arg);
+    }
+  }
+  // the value of p is read from the binary file when converting, and the
+  // input is only indexed without one
+  if (opts.p_vals.empty() && opts.bin_to_text.empty() &&
+      opts.index_file.empty())
+    usage_error("missing value of p");
+  if (!opts.index_file.empty() && !opts.p_vals.empty() &&
+      opts.num_shards == 1)
+    usage_error("--index is only used with --shard");
+  if (opts.merge_shards && opts.num_shards > 1)
+    usage_error("--merge merges the shards of a run, it is not one");
+  if (opts.to_stdout && (opts.num_shards > 1 || opts.checkpoint_every ||
+                         opts.resume || opts.merge_shards)) {
+    usage_error("--stdout can not be used with --shard, --merge, --checkpoint "
+                "or --resume");
+  }
+  // the heuristic does not give Clar numbers to count the structures of, and
+  // there is no room for the counts in the lines written to stdout
+  if (opts.count_structures && (opts.heuristic_only || opts.to_stdout)) {
+    usage_error("--count-structures and --list-structures can not be used "
+                "with --heuristic-only or --stdout");
+  }
+  // the matching callback completes the relaxation of a single isomer
+  if (opts.match_heuristic && opts.batch_size > 1)
+    usage_error("--match-heuristic can not be used with --batch");
+  // there is no room for the bounds in the lines written to stdout either
+  if (opts.screen && opts.to_stdout)
+    usage_error("--screen can not be used with --stdout");
+  // tuning only solves samples of the input with Gurobi, and writes no out
+  // files
+  if (!opts.tune_file.empty() &&
+      (opts.engine != GUROBI || opts.heuristic_only || opts.to_stdout ||
+       opts.num_shards > 1 || opts.merge_shards || opts.checkpoint_every ||
+       opts.resume)) {
+    usage_error("--tune can not be used with --engine native, "
+                "--heuristic-only, --stdout, --shard, --merge, --checkpoint "
+                "or --resume");
+  }
+  // a binary stream has one header, so room for one value of p
+  if (opts.to_stdout && opts.binary_out && opts.p_vals.size() > 1)
+    usage_error("--stdout with --binary-out takes one value of p");
+  // keep saving checkpoints when resuming
+  if (opts.resume && opts.checkpoint_every == 0)
+    opts.checkpoint_every = DEFAULT_CHECKPOINT;
+  // the out file names only have room for two digits of p
+  for (int p : opts.p_vals) {
+    if (p < 0 || p > 99)
+      usage_error("invalid value of p " + to_string(p));
+  }
+  return opts;
+}
+
+int main(int argc, char *argv[]) {
+  const Options opts = parse_args(argc, argv);
+  const int num_p = opts.p_vals.size();
+  if (opts.merge_shards) {
+    merge_shards(opts);
+    return 0;
+  }
+  // isomers are read from stdin
+  Input in(STDIN_FILENO);
+  if (!opts.bin_to_text.empty()) {
+    bin_to_text(opts.bin_to_text, in);
+    return 0;
+  }
+  if (!opts.tune_file.empty()) {
+    tune_params(opts, in);
+    return 0;
+  }
+  if (opts.p_vals.empty()) {
+    index_input(opts, in);
+    return 0;
+  }
+  // continue after the last isomer of the checkpoint, the out files are cut
+  // back to the checkpoint before they are opened
+  int first_id = 0;
+  size_t offset = 0;
+  // a shard only reads its block of the isomers
+  int shard_first = 0, shard_end = 0;
+  if (opts.num_shards > 1) {
+    shard_input(opts, in, shard_first, shard_end);
+    first_id = shard_first;
+  }
+  if (opts.resume && load_checkpoint(opts, first_id, offset)) {
+    in.seek(offset);
+  }
   Fullerene F;
-  // out files
-  string out_file_names[NFILE] = {"output/pp_anionic_clar_num",
-                                  "output/pp_r_pent", "output/pp_r_hex",
-                                  "output/pp_match_e"};
-  ofstream out_files_ptr[NFILE];
-  open_out_file(p, out_file_names, out_files_ptr);
-
-  // define gurobi solve environments
-  GRBEnv grb_env = GRBEnv(true);
-  grb_env.set(GRB_IntParam_OutputFlag, DEBUG_GUROBI);
-  grb_env.start();
-
-  int graph_num = 0;
-  // while there are isomers to read in
-  while (read_fullerene(F, p)) {
-    F.id = graph_num;
-    // construct planar dual graph
-    construct_planar_dual(F, p);
-    // attempt to find p-anionic Clar structure
-    p_anionic_clar_lp(F, p, grb_env, out_files_ptr);
-
-#if DEBUG
-    cout << "Graph number " << graph_num << endl;
-    print_primal(F.n, F.primal);
-    print_dual(F.dual_n, F.dual);
-#endif
-    graph_num++;
-  }
-  close_files(out_files_ptr);
+  // out files, one set for each value of p
+  Out_files out;
+  open_out_files(opts, out);
+  vector<Out_ptrs> out_files_ptr(num_p);
+  for (int k = 0; k < num_p; k++) {
+    get_out_ptrs(out.files[k].data(), out_files_ptr[k].data());
+  }
+
+  // solutions of earlier runs
+  Clar_cache cache(opts.cache_file);
+  Run_stats stats;
+  Stats_log log(opts, in, first_id);
+
+  int graph_num = first_id;
+  // solve the isomers on a pool of worker threads, batches are always solved
+  // there. So is a stream, whose reader thread reads ahead of the solves
+  if (opts.num_threads > 1 || opts.batch_size > 1 || opts.to_stdout) {
+    graph_num = run_pipeline(opts, in, out, cache, log, first_id, stats);
+  } else {
+    // define gurobi solve environments, the native engine and the heuristic
+    // do not need a license so the environment is never started
+    GRBEnv grb_env = GRBEnv(true);
+    if (opts.engine == GUROBI && !opts.heuristic_only) {
+      grb_env.set(GRB_IntParam_OutputFlag, DEBUG_GUROBI);
+      grb_env.start();
+    }
+
+    Clock::time_point start = Clock::now();
+    // while there are isomers to read in
+    while (read_fullerene(in, F, opts.p_vals[0])) {
+      F.id = graph_num;
+      F.offset = in.offset();
+      F.stats = Isomer_stats();
+      F.stats.read_us = lap_us(start);
+      solve_isomer(F, opts, grb_env, cache, out_files_ptr, stats);
+      log.add(F);
+      graph_num++;
+      if (opts.checkpoint_every && graph_num % opts.checkpoint_every == 0)
+        save_checkpoint(opts, out, graph_num, in.offset());
+      start = Clock::now();
+    }
+  }
+  // a finished run resumes to nothing left to do
+  if (opts.checkpoint_every)
+    save_checkpoint(opts, out, graph_num, in.offset());
+  close_out_files(out);
+  log.finish();
+  if (opts.num_shards > 1)
+    save_shard_range(opts, shard_first, shard_end);
+  // only runs that ask for a report get one
+  if (opts.progress_secs || !opts.stats_file.empty()) {
+    cerr << stats.num_by_bound << " of " << stats.num_solves
+         << " solves settled by the upper bound" << endl;
+  }
 }
@@ -0,0 +1,434 @@
+#include "include.h"
+#include <algorithm>
+
+Matching::Matching(const Fullerene(&F))
+    : F(F), in_graph(F.n, 1), mate(F.n, -1), parent(F.n), base(F.n),
+      queue(F.n), used(F.n), in_blossom(F.n), on_path(F.n) {
+  // start from a greedy matching, most vertices are matched by it
+  for (int v = 0; v < F.n; v++) {
+    for (int j = 0; j < 3 && mate[v] == -1; j++) {
+      const int u = F.primal[v].adj_v[j];
+      if (mate[u] == -1) {
+        mate[v] = u;
+        mate[u] = v;
+      }
+    }
+  }
+}
+
+void Matching::remove_face(const int f) {
+  for (int k = 0; k < F.dual[f].size; k++) {
+    const int v = F.dual[f].vertices[k];
+    // the partner of v is exposed until the next augmentation
+    if (mate[v] != -1)
+      mate[mate[v]] = -1;
+    mate[v] = -1;
+    in_graph[v] = 0;
+  }
+}
+
+void Matching::add_face(const int f) {
+  // the vertices of f come back exposed, match them along the face where
+  // possible so that little is left for the augmentations
+  for (int k = 0; k < F.dual[f].size; k++) {
+    in_graph[F.dual[f].vertices[k]] = 1;
+  }
+  for (int k = 0; k < F.dual[f].size; k++) {
+    const int v = F.dual[f].vertices[k];
+    const int u = F.dual[f].vertices[(k + 1) % F.dual[f].size];
+    if (mate[v] == -1 && mate[u] == -1) {
+      mate[v] = u;
+      mate[u] = v;
+    }
+  }
+}
+
+bool Matching::is_perfect() {
+  for (int v = 0; v < F.n; v++) {
+    // if no augmenting path starts at an exposed vertex, it stays exposed in
+    // every maximum matching, so there is no perfect matching
+    if (in_graph[v] && mate[v] == -1 && !augment(v))
+      return false;
+  }
+  return true;
+}
+
+// Edmonds' blossom algorithm. Fullerenes are not bipartite, so odd cycles
+// (blossoms) are contracted to their base while searching for an augmenting
+// path. Grows an alternating tree from the exposed vertex root, returns true
+// if an augmenting path was found (and the matching augmented along it)
+bool Matching::augment(const int root) {
+  for (int v = 0; v < F.n; v++) {
+    used[v] = 0;
+    parent[v] = -1;
+    base[v] = v;
+  }
+  int head = 0, tail = 0;
+  used[root] = 1;
+  queue[tail++] = root;
+  while (head < tail) {
+    const int v = queue[head++];
+    for (int j = 0; j < 3; j++) {
+      const int u = F.primal[v].adj_v[j];
+      if (!in_graph[u] || base[v] == base[u] || mate[v] == u)
+        continue;
+      // u closes an odd cycle, contract it
+      if (u == root || (mate[u] != -1 && parent[mate[u]] != -1)) {
+        const int cur_base = lca(v, u);
+        for (int w = 0; w < F.n; w++) {
+          in_blossom[w] = 0;
+        }
+        mark_path(v, cur_base, u);
+        mark_path(u, cur_base, v);
+        for (int w = 0; w < F.n; w++) {
+          if (in_graph[w] && in_blossom[base[w]]) {
+            base[w] = cur_base;
+            if (!used[w]) {
+              used[w] = 1;
+              queue[tail++] = w;
+            }
+          }
+        }
+      } else if (parent[u] == -1) {
+        parent[u] = v;
+        // u is exposed, flip the matching along the path back to root
+        if (mate[u] == -1) {
+          int cur = u;
+          while (cur != -1) {
+            const int prev = parent[cur], next = mate[prev];
+            mate[cur] = prev;
+            mate[prev] = cur;
+            cur = next;
+          }
+          return true;
+        }
+        used[mate[u]] = 1;
+        queue[tail++] = mate[u];
+      }
+    }
+  }
+  return false;
+}
+
+// lowest common ancestor of the bases of a and b in the alternating tree
+int Matching::lca(int a, int b) {
+  for (int v = 0; v < F.n; v++) {
+    on_path[v] = 0;
+  }
+  while (true) {
+    a = base[a];
+    on_path[a] = 1;
+    if (mate[a] == -1)
+      break;
+    a = parent[mate[a]];
+  }
+  while (true) {
+    b = base[b];
+    if (on_path[b])
+      return b;
+    b = parent[mate[b]];
+  }
+}
+
+void Matching::mark_path(int v, const int cur_base, int child) {
+  while (base[v] != cur_base) {
+    in_blossom[base[v]] = in_blossom[base[mate[v]]] = 1;
+    parent[v] = child;
+    child = mate[v];
+    v = parent[mate[v]];
+  }
+}
+
+void Matching::get_edges(Bitset(&match_e)) const {
+  match_e.assign(F.num_edges);
+  for (int v = 0; v < F.n; v++) {
+    for (int j = 0; j < 3; j++) {
+      if (in_graph[v] && mate[v] == F.primal[v].adj_v[j])
+        match_e.set(F.primal[v].edges[j]);
+    }
+  }
+}
+
+// the perfect matchings of the graph, counted by the transfer matrix of
+// counter with no resonant faces
+long Matching::count_perfect(const Structure_counter(&counter)) const {
+  long num_face_sets, num_matchings;
+  counter.count(in_graph, 0, 0, num_face_sets, num_matchings);
+  return num_matchings;
+}
+
+// Vertices are numbered breadth first from a vertex of a pentagon, the one
+// from which the faces span the fewest vertices in total, so that few faces
+// are open at once. On a nanotube that is a vertex of a cap, so the vertices
+// go around the tube ring by ring
+Structure_counter::Structure_counter(const Fullerene(&F))
+    : F(F), order(F.n), pos(F.n),
+      first_faces(F.n), pents_after(F.n + 1, 0) {
+  vector<int> best_pos;
+  int best_span = F.n * F.dual_n;
+  for (int f : F.pents) {
+    for (int k = 0; k < 5; k++) {
+      const int s = F.dual[f].vertices[k];
+      fill(pos.begin(), pos.end(), -1);
+      pos[s] = 0;
+      order[0] = s;
+      for (int head = 0, tail = 1; head < F.n; head++) {
+        const int v = order[head];
+        for (int j = 0; j < 3; j++) {
+          const int u = F.primal[v].adj_v[j];
+          if (pos[u] == -1) {
+            pos[u] = tail;
+            order[tail++] = u;
+          }
+        }
+      }
+      int span = 0;
+      for (int g = 0; g < F.dual_n && span < best_span; g++) {
+        int lo = F.n, hi = 0;
+        for (int i = 0; i < F.dual[g].size; i++) {
+          lo = min(lo, pos[F.dual[g].vertices[i]]);
+          hi = max(hi, pos[F.dual[g].vertices[i]]);
+        }
+        span += hi - lo;
+      }
+      if (span < best_span) {
+        best_span = span;
+        best_pos = pos;
+      }
+    }
+  }
+  pos = best_pos;
+  for (int v = 0; v < F.n; v++) {
+    order[pos[v]] = v;
+  }
+  // each face is decided at its first vertex
+  for (int g = 0; g < F.dual_n; g++) {
+    int first = F.n;
+    for (int i = 0; i < F.dual[g].size; i++) {
+      first = min(first, pos[F.dual[g].vertices[i]]);
+    }
+    first_faces[first].push_back(g);
+    pents_after[first] += F.dual[g].size == 5;
+  }
+  for (int i = F.n - 1; i >= 0; i--) {
+    pents_after[i] += pents_after[i + 1];
+  }
+}
+
+// hash of the key of a state of the transfer matrix
+struct Key_hash {
+  size_t operator()(const vector<uint64_t>(&key)) const {
+    uint64_t h = 0;
+    for (uint64_t x : key) {
+      h = (h ^ x) * 0x9e3779b97f4a7c15;
+      h ^= h >> 29;
+    }
+    return h;
+  }
+};
+
+// The counts grow exponentially with n and pass the largest long from about
+// 270 vertices on, so they are checked rather than left to wrap around
+long add_counts(const Fullerene(&F), const int p, const long a, const long b) {
+  long sum;
+  if (__builtin_add_overflow(a, b, &sum))
+    throw_error(F.n, p, F.id, "\nToo many Clar structures to count");
+  return sum;
+}
+
+long mul_counts(const Fullerene(&F), const int p, const long a, const long b) {
+  long product;
+  if (__builtin_mul_overflow(a, b, &product))
+    throw_error(F.n, p, F.id, "\nToo many Clar structures to count");
+  return product;
+}
+
+// The vertices are decided in order, each one either covered by a resonant
+// face, which is chosen at its first vertex, or matched to a later neighbour.
+// A state is the number of faces and pentagons chosen, the undecided
+// vertices already covered by the chosen faces and, for the different ways
+// of matching the decided vertices, which undecided vertices they match
+// along with the number of ways. It is kept as a key of words:
+//   num_faces num_pents {face cover} then {matched} num_ways for each way
+// and maps to the number of sets of chosen faces leading to it. Sets of faces
+// whose futures are the same are counted together, so the states only grow
+// with the vertices between the decided and undecided ones. Sets of vertices
+// take W 64 bit words, fixed at compile time as in the native engine
+template <int W>
+void Structure_counter::count_words(const vector<char>(&in_graph), const int p,
+                                    const int num_faces, long(&num_face_sets),
+                                    long(&num_structures)) const {
+  using Words = array<uint64_t, W>;
+  unordered_map<vector<uint64_t>, long, Key_hash> states, next;
+  vector<uint64_t> head(2 + W, 0), key;
+  vector<pair<Words, long>> ways;
+  for (int v = 0; v < F.n; v++) {
+    // vertices out of the graph are left as covered by a face
+    if (!in_graph[v])
+      head[2 + v / 64] |= uint64_t(1) << (v % 64);
+  }
+  key = head;
+  key.insert(key.end(), W, 0);
+  key.push_back(1);
+  states[key] = 1;
+  for (int i = 0; i < F.n; i++) {
+    const int v = order[i], w = v / 64;
+    const uint64_t bit = uint64_t(1) << (v % 64);
+    // add the state with the face cover of head and the ways in ways, unless
+    // the pentagons or the free vertices left can not make up the faces
+    auto emit = [&](const long num_sets) {
+      if (ways.empty())
+        return;
+      const int need_pents = p - (int)head[1];
+      int free_v = F.n - i - 1 - 5 * need_pents;
+      for (int x = 0; x < W; x++) {
+        free_v -= __builtin_popcountll(head[2 + x]);
+      }
+      if (need_pents > pents_after[i + 1] || free_v < 0 ||
+          (int)head[0] + need_pents + free_v / 6 < num_faces)
+        return;
+      sort(ways.begin(), ways.end(),
+           [](const pair<Words, long>(&a), const pair<Words, long>(&b)) {
+             return a.first < b.first;
+           });
+      key = head;
+      for (size_t k = 0; k < ways.size(); k++) {
+        if (k > 0 && ways[k].first == ways[k - 1].first) {
+          key.back() = add_counts(F, p, (long)key.back(), ways[k].second);
+          continue;
+        }
+        key.insert(key.end(), ways[k].first.begin(), ways[k].first.end());
+        key.push_back(ways[k].second);
+      }
+      long &num = next[key];
+      num = add_counts(F, p, num, num_sets);
+    };
+    next.clear();
+    for (const auto &state : states) {
+      const vector<uint64_t> &cur = state.first;
+      const uint64_t *cover = &cur[2];
+      const size_t num_ways = (cur.size() - 2 - W) / (W + 1);
+      auto way_at = [&](const size_t k) {
+        const uint64_t *x = &cur[2 + W + k * (W + 1)];
+        pair<Words, long> way;
+        copy(x, x + W, way.first.begin());
+        way.second = (long)x[W];
+        return way;
+      };
+      head.assign(cur.begin(), cur.begin() + 2 + W);
+      head[2 + w] &= ~bit;
+      ways.clear();
+      if (cover[w] & bit) {
+        // v is on a chosen face
+        for (size_t k = 0; k < num_ways; k++) {
+          ways.push_back(way_at(k));
+        }
+        emit(state.second);
+        continue;
+      }
+      // v is matched, to an earlier vertex or to a later neighbour
+      for (size_t k = 0; k < num_ways; k++) {
+        pair<Words, long> way = way_at(k);
+        Words &matched = way.first;
+        if (matched[w] & bit) {
+          matched[w] &= ~bit;
+          ways.push_back(way);
+          continue;
+        }
+        for (int j = 0; j < 3; j++) {
+          const int u = F.primal[v].adj_v[j];
+          const uint64_t u_bit = uint64_t(1) << (u % 64);
+          if (pos[u] < i || ((cover[u / 64] | matched[u / 64]) & u_bit))
+            continue;
+          matched[u / 64] |= u_bit;
+          ways.push_back(way);
+          matched[u / 64] &= ~u_bit;
+        }
+      }
+      emit(state.second);
+      // or v is on a face first decided at v
+      for (int f : first_faces[i]) {
+        const int is_pent = F.dual[f].size == 5;
+        if ((int)cur[0] == num_faces || (int)cur[1] + is_pent > p)
+          continue;
+        Words face{};
+        bool free = true;
+        for (int k = 0; k < F.dual[f].size; k++) {
+          const int u = F.dual[f].vertices[k];
+          face[u / 64] |= uint64_t(1) << (u % 64);
+          free = free && !((cover[u / 64] >> (u % 64)) & 1);
+        }
+        if (!free)
+          continue;
+        head.assign(cur.begin(), cur.begin() + 2 + W);
+        head[0]++;
+        head[1] += is_pent;
+        for (int x = 0; x < W; x++) {
+          head[2 + x] |= face[x];
+        }
+        head[2 + w] &= ~bit;
+        ways.clear();
+        for (size_t k = 0; k < num_ways; k++) {
+          const pair<Words, long> way = way_at(k);
+          bool clash = false;
+          for (int x = 0; x < W; x++) {
+            clash = clash || (way.first[x] & face[x]);
+          }
+          if (!clash)
+            ways.push_back(way);
+        }
+        emit(state.second);
+      }
+    }
+    states.swap(next);
+  }
+  for (const auto &state : states) {
+    const vector<uint64_t> &cur = state.first;
+    if ((int)cur[0] != num_faces || (int)cur[1] != p)
+      continue;
+    num_face_sets = add_counts(F, p, num_face_sets, state.second);
+    // every vertex is decided, so the one way left holds the number of
+    // perfect matchings of the vertices not on the faces
+    num_structures = add_counts(
+        F, p, num_structures, mul_counts(F, p, state.second, (long)cur.back()));
+  }
+}
+
+void Structure_counter::count(const vector<char>(&in_graph), const int p,
+                              const int num_faces, long(&num_face_sets),
+                              long(&num_structures)) const {
+  num_face_sets = num_structures = 0;
+  if (num_faces < 0)
+    return;
+  switch ((F.n + 63) / 64) {
+  case 1:
+    count_words<1>(in_graph, p, num_faces, num_face_sets, num_structures);
+    break;
+  case 2:
+    count_words<2>(in_graph, p, num_faces, num_face_sets, num_structures);
+    break;
+  case 3:
+  case 4:
+    count_words<4>(in_graph, p, num_faces, num_face_sets, num_structures);
+    break;
+  case 5:
+  case 6:
+  case 7:
+  case 8:
+    count_words<8>(in_graph, p, num_faces, num_face_sets, num_structures);
+    break;
+  case 9:
+  case 10:
+  case 11:
+  case 12:
+  case 13:
+  case 14:
+  case 15:
+  case 16:
+    count_words<16>(in_graph, p, num_faces, num_face_sets, num_structures);
+    break;
+  default:
+    throw_error(F.n, p, F.id,
+                "\nClar structures are counted for at most 1024 vertices");
+  }
+}
@@ -0,0 +1,436 @@
+#include "include.h"
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+
+// states of a vertex during the search, otherwise a vertex records the id of
+// the resonant face it lies on
+constexpr int UNDECIDED = -1;
+// the vertex is not on a resonant face and must be covered by a matching edge
+constexpr int MATCHED = -2;
+
+// Branch and bound over the faces of the planar dual. At each node the lowest
+// undecided vertex is either covered by one of its (at most 3) available faces
+// or marked as matched, so every set of independent faces is visited at most
+// once. Once every vertex is decided, the matched vertices are checked for a
+// perfect matching. The matching follows the faces chosen along the search,
+// so consecutive leaves only repair the few vertices that changed. Given an
+// orbit of faces under the automorphism group, only structures where the
+// first face of the orbit is resonant if any face of it is are searched,
+// every other structure has a symmetric copy among them.
+//
+// The same search lists the Clar structures once the Clar number is known:
+// faces beyond it are never chosen, branches that can not reach it are cut
+// and every leaf that meets it is listed.
+//
+// The decided vertices are also kept as a bitset of W 64 bit words, so that
+// checking whether a face is available is a few word operations. W is fixed
+// at compile time (see native_p_range) so that these loops unroll.
+template <int W> class Native_bb {
+public:
+  Native_bb(const Fullerene(&F), const vector<int>(&orbit))
+      : F(F), p(0), cover(F.n, UNDECIDED), num_undecided(F.n), best(-1),
+        target(0), max_faces(F.dual_n),
+        orbit_first(orbit.size() > 1 ? orbit[0] : -1), num_orbit_chosen(0),
+        count(nullptr), counter(nullptr), matching(F), in_orbit(F.dual_n, 0),
+        face_bits(F.dual_n), decided{}, hex_bits{} {
+    for (size_t i = 1; i < orbit.size(); i++) {
+      in_orbit[orbit[i]] = 1;
+    }
+    for (int f = 0; f < F.dual_n; f++) {
+      Bits &bits = face_bits[f];
+      bits.fill(0);
+      for (int k = 0; k < F.dual[f].size; k++) {
+        set_bit(bits, F.dual[f].vertices[k]);
+      }
+    }
+    for (int f : F.hexes) {
+      set_bit(hex_bits, f);
+    }
+  }
+
+  // returns the p-anionic Clar number and a Clar structure in sol, or -1 if
+  // there is no p-anionic resonance structure. bound is an upper bound on the
+  // Clar number (-1 if there is no structure), the search stops once it has a
+  // structure meeting it. If start is not -1, sol holds a structure with
+  // start resonant faces to begin from. The search leaves every vertex
+  // undecided, so the same object solves each value of p
+  int solve(const int p_val, const int bound, const int start,
+            Clar_sol(&sol)) {
+    p = p_val;
+    best = start;
+    target = bound;
+    if (start != -1) {
+      best_faces.clear();
+      for (int f = 0; f < F.dual_n; f++) {
+        if (sol.res_face[f])
+          best_faces.push_back(f);
+      }
+      best_match_e = sol.match_e;
+    }
+    if (bound != -1)
+      search(0, 0, 0);
+    if (best == -1) {
+      sol.res_face.clear();
+      sol.match_e.clear();
+      return -1;
+    }
+    sol.res_face.assign(F.dual_n);
+    for (int f : best_faces) {
+      sol.res_face.set(f);
+    }
+    sol.match_e = best_match_e;
+    return best;
+  }
+
+  // list the sets of faces of the resonance structures with clar_num resonant
+  // faces, i.e. the Clar structures, into clar_count, counting their perfect
+  // matchings with structures. The search must not break symmetry
+  void enumerate(const int p_val, const int clar_num,
+                 const Structure_counter(&structures),
+                 Clar_count(&clar_count)) {
+    p = p_val;
+    target = max_faces = clar_num;
+    // cut the branches that can not reach the Clar number
+    best = clar_num - 1;
+    count = &clar_count;
+    counter = &structures;
+    search(0, 0, 0);
+    max_faces = F.dual_n;
+    count = nullptr;
+  }
+
+private:
+  void search(int v, const int num_faces, const int num_pents) {
+    if (best == target || num_faces > max_faces)
+      return;
+    // every vertex below v has already been decided
+    while (v < F.n && cover[v] != UNDECIDED)
+      v++;
+    if (v == F.n) {
+      check_leaf(num_faces, num_pents);
+      return;
+    }
+    if (num_faces + upper_bound(num_pents) <= best || !orbit_first_open())
+      return;
+
+    // cover v by one of its faces
+    for (int j = 0; j < 3; j++) {
+      const int f = F.primal[v].faces[j];
+      const int is_pent = F.dual[f].size == 5;
+      if ((is_pent && num_pents == p) || !is_available(f))
+        continue;
+      set_face(f, f);
+      chosen.push_back(f);
+      num_orbit_chosen += in_orbit[f];
+      if (partners_remain(f))
+        search(v + 1, num_faces + 1, num_pents + is_pent);
+      num_orbit_chosen -= in_orbit[f];
+      chosen.pop_back();
+      set_face(f, UNDECIDED);
+    }
+    // or leave v to the matching
+    cover[v] = MATCHED;
+    set_bit(decided, v);
+    num_undecided--;
+    if (has_partner(v))
+      search(v + 1, num_faces, num_pents);
+    cover[v] = UNDECIDED;
+    clear_bit(decided, v);
+    num_undecided++;
+  }
+
+  void check_leaf(const int num_faces, const int num_pents) {
+    if (num_pents != p || num_faces <= best || !orbit_first_open())
+      return;
+    // every vertex that is not on a chosen face is matched
+    if (!matching.is_perfect())
+      return;
+    if (count) {
+      if (num_faces != target)
+        return;
+      count->num_face_sets++;
+      count->num_structures = add_counts(F, p, count->num_structures,
+                                         matching.count_perfect(*counter));
+      count->face_sets.push_back(chosen);
+      sort(count->face_sets.back().begin(), count->face_sets.back().end());
+      return;
+    }
+    best = num_faces;
+    best_faces = chosen;
+    matching.get_edges(best_match_e);
+  }
+
+  // bound on the number of faces that can still be made resonant
+  int upper_bound(const int num_pents) {
+    const int need_pents = p - num_pents;
+    // the remaining pentagons cover 5 vertices each
+    int free_v = num_undecided - 5 * need_pents;
+    if (free_v < 0)
+      return -F.dual_n;
+    int avail_pents = 0;
+    for (int f : F.pents) {
+      avail_pents += is_available(f);
+    }
+    if (avail_pents < need_pents)
+      return -F.dual_n;
+    // the faces around a vertex are pairwise adjacent, so each undecided
+    // vertex gives a clique of available hexagons. The number of cliques
+    // needed to cover the available hexagons bounds how many can be
+    // independent. Hexagons are only looked at once, so the ones that are not
+    // available are marked seen as well
+    Bits seen;
+    for (int w = 0; w < W; w++) {
+      seen[w] = ~hex_bits[w];
+    }
+    int cliques = 0;
+    for (int w = 0; w < W; w++) {
+      uint64_t undecided = ~decided[w];
+      if (64 * (w + 1) > F.n)
+        undecided &= (uint64_t(1) << (F.n - 64 * w)) - 1;
+      while (undecided) {
+        const int u = 64 * w + __builtin_ctzll(undecided);
+        undecided &= undecided - 1;
+        bool new_clique = false;
+        for (int j = 0; j < 3; j++) {
+          const int f = F.primal[u].faces[j];
+          if (test_bit(seen, f))
+            continue;
+          set_bit(seen, f);
+          new_clique = new_clique || is_available(f);
+        }
+        cliques += new_clique;
+      }
+    }
+    return need_pents + min(free_v / 6, cliques);
+  }
+
+  // once a face of the orbit is resonant, its first face must be (or still
+  // can be made) resonant too
+  bool orbit_first_open() const {
+    if (num_orbit_chosen == 0)
+      return true;
+    return cover[F.dual[orbit_first].vertices[0]] == orbit_first ||
+           is_available(orbit_first);
+  }
+
+  // a face can be made resonant if none of its vertices are decided
+  bool is_available(const int f) const {
+    uint64_t overlap = 0;
+    for (int w = 0; w < W; w++) {
+      overlap |= face_bits[f][w] & decided[w];
+    }
+    return overlap == 0;
+  }
+
+  void set_face(const int f, const int state) {
+    for (int k = 0; k < F.dual[f].size; k++) {
+      cover[F.dual[f].vertices[k]] = state;
+    }
+    if (state == UNDECIDED) {
+      for (int w = 0; w < W; w++) {
+        decided[w] &= ~face_bits[f][w];
+      }
+      num_undecided += F.dual[f].size;
+      matching.add_face(f);
+    } else {
+      for (int w = 0; w < W; w++) {
+        decided[w] |= face_bits[f][w];
+      }
+      num_undecided -= F.dual[f].size;
+      matching.remove_face(f);
+    }
+  }
+
+  // a matched vertex needs a neighbour that is not on a resonant face
+  bool has_partner(const int v) const {
+    for (int j = 0; j < 3; j++) {
+      if (cover[F.primal[v].adj_v[j]] < 0)
+        return true;
+    }
+    return false;
+  }
+
+  // check the matched neighbours of face f still have a partner
+  bool partners_remain(const int f) const {
+    for (int k = 0; k < F.dual[f].size; k++) {
+      const int w = F.dual[f].vertices[k];
+      for (int j = 0; j < 3; j++) {
+        const int u = F.primal[w].adj_v[j];
+        if (cover[u] == MATCHED && !has_partner(u))
+          return false;
+      }
+    }
+    return true;
+  }
+
+  typedef array<uint64_t, W> Bits;
+
+  static bool test_bit(const Bits(&bits), const int i) {
+    return (bits[i >> 6] >> (i & 63)) & 1;
+  }
+  static void set_bit(Bits(&bits), const int i) {
+    bits[i >> 6] |= uint64_t(1) << (i & 63);
+  }
+  static void clear_bit(Bits(&bits), const int i) {
+    bits[i >> 6] &= ~(uint64_t(1) << (i & 63));
+  }
+
+  const Fullerene &F;
+  int p;
+  vector<int> cover;
+  int num_undecided, best, target, max_faces, orbit_first, num_orbit_chosen;
+  // the structures being listed and the counter of their matchings, null
+  // when solving
+  Clar_count *count;
+  const Structure_counter *counter;
+  vector<int> chosen, best_faces;
+  Matching matching;
+  Bitset best_match_e;
+  vector<char> in_orbit;
+  // the vertices of each face, the decided vertices and the hexagons
+  vector<Bits> face_bits;
+  Bits decided, hex_bits;
+};
+
+// Solve for each value of p with W words per bitset, clar_nums[k] is -1 if
+// there is no resonance structure for the kth value of p
+template <int W>
+void native_p_range(const Fullerene(&F), const vector<int>(&p_vals),
+                    const vector<int>(&bounds), const vector<int>(&orbit),
+                    vector<int>(&clar_nums), vector<Clar_sol>(&sols)) {
+  Clock::time_point timer = Clock::now();
+  Native_bb<W> bb(F, orbit);
+  for (size_t k = 0; k < p_vals.size(); k++) {
+    // the structure found by the heuristic prunes the search from the start
+    const int start =
+        bounds[k] == -1 ? -1 : heuristic_anionic_clar(F, p_vals[k], sols[k]);
+    clar_nums[k] = bb.solve(p_vals[k], bounds[k], start, sols[k]);
+  }
+  F.stats.optimize_us += lap_us(timer);
+}
+
+// Run run(integral_constant<int, W>()) with the specialisation W of the
+// search for the size of F. Both the vertices and the faces (n / 2 + 2 of
+// them) must fit in the bitsets
+template <class Run>
+void native_dispatch(const Fullerene(&F), const int p, Run run) {
+  switch ((F.n + 63) / 64) {
+  case 1:
+    run(integral_constant<int, 1>());
+    break;
+  case 2:
+    run(integral_constant<int, 2>());
+    break;
+  case 3:
+    run(integral_constant<int, 3>());
+    break;
+  case 4:
+    run(integral_constant<int, 4>());
+    break;
+  case 5:
+  case 6:
+  case 7:
+  case 8:
+    run(integral_constant<int, 8>());
+    break;
+  case 9:
+  case 10:
+  case 11:
+  case 12:
+  case 13:
+  case 14:
+  case 15:
+  case 16:
+    run(integral_constant<int, 16>());
+    break;
+  default:
+    throw_error(F.n, p, F.id,
+                "\nThe native engine handles at most 1024 vertices");
+  }
+}
+
+void native_dispatch(const Fullerene(&F), const vector<int>(&p_vals),
+                     const vector<int>(&bounds), const vector<int>(&orbit),
+                     vector<int>(&clar_nums), vector<Clar_sol>(&sols)) {
+  native_dispatch(F, p_vals[0], [&](auto width) {
+    native_p_range<decltype(width)::value>(F, p_vals, bounds, orbit,
+                                           clar_nums, sols);
+  });
+}
+
+// counts[k] are the Clar structures of F for the kth value of p, whose
+// p-anionic Clar number is clar_nums[k] (-1 if there is no structure). Their
+// number can grow exponentially with n, so unless they are listed they are
+// counted by the transfer matrix without visiting them
+void clar_structures(const Fullerene(&F), const vector<int>(&p_vals),
+                     const vector<int>(&clar_nums), const bool list,
+                     vector<Clar_count>(&counts)) {
+  counts.assign(p_vals.size(), Clar_count());
+  const Structure_counter counter(F);
+  if (!list) {
+    const vector<char> in_graph(F.n, 1);
+    for (size_t k = 0; k < p_vals.size(); k++) {
+      counter.count(in_graph, p_vals[k], clar_nums[k], counts[k].num_face_sets,
+                    counts[k].num_structures);
+    }
+    return;
+  }
+  native_dispatch(F, p_vals[0], [&](auto width) {
+    Native_bb<decltype(width)::value> bb(F, vector<int>());
+    for (size_t k = 0; k < p_vals.size(); k++) {
+      bb.enumerate(p_vals[k], clar_nums[k], counter, counts[k]);
+    }
+  });
+}
+
+// the p-anionic Clar number of F and a Clar structure in sol, -1 if there is
+// no p-anionic resonance structure. orbit is a face orbit used for symmetry
+// breaking, or empty
+int native_anionic_clar(const Fullerene(&F), const int p,
+                        const vector<int>(&orbit), Clar_sol(&sol)) {
+  const vector<int> p_vals(1, p);
+  vector<int> bounds, clar_nums(1);
+  vector<Clar_sol> sols(1);
+  clar_upper_bounds(F, p_vals, bounds);
+  native_dispatch(F, p_vals, bounds, orbit, clar_nums, sols);
+  sol = move(sols[0]);
+  return clar_nums[0];
+}
+
+// returns the number of values of p settled by the upper bounds
+int p_range_anionic_clar_native(const Fullerene(&F), const Options(&opts),
+                                const vector<int>(&bounds),
+                                vector<Out_ptrs>(&out_files_ptr),
+                                vector<int>(&clar_nums),
+                                vector<Clar_sol>(&sols)) {
+  const vector<int> &p_vals = opts.p_vals;
+  vector<int> orbit;
+  if (opts.symmetry)
+    largest_face_orbit(F, orbit);
+  native_dispatch(F, p_vals, bounds, orbit, clar_nums, sols);
+  int num_by_bound = 0;
+  for (size_t k = 0; k < p_vals.size(); k++) {
+    const int p = p_vals[k];
+    num_by_bound += clar_nums[k] == bounds[k];
+#if DEBUG_CLAR
+    cout << "n = " << F.n << ", p = " << p << ", graph num = " << F.id << endl;
+    cout << "Solved by branch and bound" << endl;
+#endif
+    const Clar_sol &sol = sols[k];
+    int num_res_faces = clar_nums[k];
+    if (num_res_faces == -1) {
+      // there are 0 resonant faces since no valid solution
+      num_res_faces = 0;
+    } else {
+      // check solution and grab number of resonant faces
+      num_res_faces = check_if_sol_valid(F, p, sol);
+    }
+    write_sol(F, opts, p, num_res_faces, sol, out_files_ptr[k].data());
+#if DEBUG_CLAR
+    print_sol(F, num_res_faces, sol);
+#endif
+    clar_nums[k] = num_res_faces;
+  }
+  return num_by_bound;
+}
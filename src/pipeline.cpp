@@ -0,0 +1,467 @@
+#include "include.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+// number of isomers the reader may get ahead of the workers, per worker
+constexpr int QUEUE_PER_THREAD = 4;
+
+// construct the planar dual graph and, with --symmetry, the automorphisms
+void prepare_isomer(Fullerene(&F), const Options(&opts)) {
+  Clock::time_point start = Clock::now();
+  construct_planar_dual(F, opts.p_vals[0]);
+  if (opts.symmetry)
+    automorphisms(F, F.aut_faces);
+  F.stats.dual_us += lap_us(start);
+}
+
+// the order of the automorphism group goes next to the solutions of every
+// value of p
+void write_aut_order(const Fullerene(&F), const Options(&opts),
+                     vector<Out_ptrs>(&out_files_ptr)) {
+  // there is no room for it in the lines written to stdout
+  if (!opts.symmetry || opts.to_stdout)
+    return;
+  for (size_t k = 0; k < opts.p_vals.size(); k++) {
+    *out_files_ptr[k][AUT_FILE] << F.aut_faces.size() << endl;
+  }
+}
+
+// with --count-structures, count the Clar structures of F for every value of
+// p given its p-anionic Clar numbers
+void write_structures(const Fullerene(&F), const Options(&opts),
+                      const vector<int>(&clar_nums),
+                      vector<Out_ptrs>(&out_files_ptr)) {
+  if (!opts.count_structures)
+    return;
+  vector<Clar_count> counts;
+  clar_structures(F, opts.p_vals, clar_nums, opts.list_structures, counts);
+  for (size_t k = 0; k < opts.p_vals.size(); k++) {
+    save_clar_count(counts[k], opts.list_structures, out_files_ptr[k].data());
+  }
+}
+
+// With --screen, a row for every value of p of the lower bound (the Clar
+// number, or what the heuristic found with --heuristic-only), the upper bound
+// and what settles them: max if they meet, exact if the Clar number was
+// solved for below the bound, open if they are apart. If there is no
+// structure, the upper bound is -1 and the row ends with the reason. The
+// bounds are those the engine solved against
+void write_bounds(const Options(&opts), const vector<int>(&clar_nums),
+                  const vector<int>(&bounds), const vector<string>(&certs),
+                  vector<Out_ptrs>(&out_files_ptr)) {
+  if (!opts.screen)
+    return;
+  for (size_t k = 0; k < opts.p_vals.size(); k++) {
+    string status = certs[k];
+    if (bounds[k] != -1) {
+      status = clar_nums[k] == bounds[k] ? "max"
+               : opts.heuristic_only     ? "open"
+                                         : "exact";
+    }
+    *out_files_ptr[k][BOUNDS_FILE] << clar_nums[k] << " " << bounds[k] << " "
+                                   << status << endl;
+  }
+}
+
+// look up the solution of F for p in the cache and check it, returns false if
+// there is none
+bool cached_sol(const Fullerene(&F), const Canon(&canon), const int p,
+                Clar_cache(&cache), int(&num_res_faces), Clar_sol(&sol)) {
+  if (!cache.lookup(F, canon, p, num_res_faces, sol))
+    return false;
+  if (!sol.match_e.empty() && check_if_sol_valid(F, p, sol) != num_res_faces)
+    throw_error(F.n, p, F.id, "\nCached solution has the wrong size");
+  return true;
+}
+
+void solve_isomer(Fullerene(&F), const Options(&opts), GRBEnv(&grb_env),
+                  Clar_cache(&cache), vector<Out_ptrs>(&out_files_ptr),
+                  Run_stats(&stats)) {
+  prepare_isomer(F, opts);
+
+  // the values of p the cache has a solution for are only checked, the rest
+  // are solved. The heuristic does not give Clar numbers, so it does not use
+  // the cache
+  // all_nums[k] is the Clar number of the kth value of p, which is the
+  // solve_k[j]th value of p if solved
+  const int num_p = opts.p_vals.size();
+  Options solve_opts = opts;
+  vector<Out_ptrs> solve_ptrs = out_files_ptr;
+  vector<int> all_nums(num_p), solve_k(num_p), all_bounds, solve_bounds;
+  vector<string> certs;
+  screen_bounds(F, opts, all_bounds, certs);
+  solve_bounds = all_bounds;
+  for (int k = 0; k < num_p; k++) {
+    solve_k[k] = k;
+  }
+  Canon canon;
+  const bool use_cache = cache.enabled() && !opts.heuristic_only;
+  if (use_cache) {
+    canonical_form(F, canon);
+    solve_opts.p_vals.clear();
+    solve_ptrs.clear();
+    solve_k.clear();
+    solve_bounds.clear();
+    Clar_sol sol;
+    for (int k = 0; k < num_p; k++) {
+      const int p = opts.p_vals[k];
+      if (!cached_sol(F, canon, p, cache, all_nums[k], sol)) {
+        solve_opts.p_vals.push_back(p);
+        solve_ptrs.push_back(out_files_ptr[k]);
+        solve_k.push_back(k);
+        solve_bounds.push_back(all_bounds[k]);
+        continue;
+      }
+      write_sol(F, opts, p, all_nums[k], sol, out_files_ptr[k].data());
+    }
+  }
+
+  // attempt to find p-anionic Clar structure for each value of p
+  const int num_solve = solve_opts.p_vals.size();
+  vector<int> clar_nums(num_solve);
+  vector<Clar_sol> sols(num_solve);
+  if (num_solve > 0 && opts.heuristic_only) {
+    stats.num_by_bound += p_range_anionic_clar_heuristic(
+        F, solve_opts, solve_bounds, solve_ptrs, clar_nums, sols);
+  } else if (num_solve > 0 && opts.engine == NATIVE) {
+    stats.num_by_bound += p_range_anionic_clar_native(
+        F, solve_opts, solve_bounds, solve_ptrs, clar_nums, sols);
+  } else if (num_solve > 0) {
+    stats.num_by_bound += p_range_anionic_clar_lp(
+        F, solve_opts, solve_bounds, grb_env, solve_ptrs, clar_nums, sols);
+  }
+  stats.num_solves += num_solve;
+  for (int j = 0; j < num_solve; j++) {
+    all_nums[solve_k[j]] = clar_nums[j];
+    if (use_cache)
+      cache.store(F, canon, solve_opts.p_vals[j], clar_nums[j], sols[j]);
+  }
+  write_structures(F, opts, all_nums, out_files_ptr);
+  write_bounds(opts, all_nums, all_bounds, certs, out_files_ptr);
+  write_aut_order(F, opts, out_files_ptr);
+
+#if DEBUG
+  cout << "Graph number " << F.id << endl;
+  print_primal(F.n, F.primal);
+  print_dual(F.dual_n, F.dual);
+#endif
+}
+
+void solve_batch(vector<Fullerene>(&batch), const Options(&opts),
+                 GRBEnv(&grb_env), Clar_cache(&cache),
+                 vector<vector<Out_ptrs>>(&out_files_ptr), Run_stats(&stats)) {
+  const int num_p = opts.p_vals.size();
+  if (opts.engine != GUROBI || opts.heuristic_only || batch.size() == 1) {
+    for (size_t i = 0; i < batch.size(); i++) {
+      solve_isomer(batch[i], opts, grb_env, cache, out_files_ptr[i], stats);
+    }
+    return;
+  }
+  // the isomers that the cache has a solution for every value of p for are
+  // only checked, the rest are solved together
+  vector<const Fullerene *> to_solve;
+  vector<vector<Out_ptrs>> solve_ptrs;
+  vector<Canon> canons;
+  vector<vector<int>> bounds, solve_bounds;
+  vector<vector<string>> certs, solve_certs;
+  vector<int> clar_nums(num_p);
+  vector<Clar_sol> sols(num_p);
+  for (size_t i = 0; i < batch.size(); i++) {
+    Fullerene &F = batch[i];
+    prepare_isomer(F, opts);
+    bounds.emplace_back();
+    certs.emplace_back();
+    screen_bounds(F, opts, bounds.back(), certs.back());
+    Canon canon;
+    bool cached = cache.enabled();
+    if (cached) {
+      canonical_form(F, canon);
+      for (int k = 0; k < num_p && cached; k++) {
+        cached = cached_sol(F, canon, opts.p_vals[k], cache, clar_nums[k],
+                            sols[k]);
+      }
+    }
+    if (cached) {
+      for (int k = 0; k < num_p; k++) {
+        write_sol(F, opts, opts.p_vals[k], clar_nums[k], sols[k],
+                  out_files_ptr[i][k].data());
+      }
+      write_structures(F, opts, clar_nums, out_files_ptr[i]);
+      write_bounds(opts, clar_nums, bounds[i], certs[i], out_files_ptr[i]);
+    } else {
+      to_solve.push_back(&F);
+      solve_ptrs.push_back(out_files_ptr[i]);
+      canons.push_back(move(canon));
+      solve_bounds.push_back(bounds[i]);
+      solve_certs.push_back(certs[i]);
+    }
+  }
+
+  if (!to_solve.empty()) {
+    vector<vector<int>> batch_nums;
+    vector<vector<Clar_sol>> batch_sols;
+    stats.num_by_bound +=
+        batch_anionic_clar_lp(to_solve, opts, solve_bounds, grb_env, solve_ptrs,
+                              batch_nums, batch_sols);
+    stats.num_solves += to_solve.size() * num_p;
+    for (size_t j = 0; j < to_solve.size(); j++) {
+      for (int k = 0; k < num_p && cache.enabled(); k++) {
+        cache.store(*to_solve[j], canons[j], opts.p_vals[k],
+                    batch_nums[j][k], batch_sols[j][k]);
+      }
+      write_structures(*to_solve[j], opts, batch_nums[j], solve_ptrs[j]);
+      write_bounds(opts, batch_nums[j], solve_bounds[j], solve_certs[j],
+                   solve_ptrs[j]);
+    }
+  }
+  for (size_t i = 0; i < batch.size(); i++) {
+    write_aut_order(batch[i], opts, out_files_ptr[i]);
+  }
+}
+
+// state shared between the reader, the workers and the writer
+class Pipeline {
+public:
+  Pipeline(const Options(&opts), Input(&in), Out_files(&out),
+           Clar_cache(&cache), Stats_log(&log), const int first_id)
+      : opts(opts), in(in), cache(cache), log(log), first_id(first_id),
+        capacity(QUEUE_PER_THREAD * opts.num_threads * opts.batch_size),
+        next_write(first_id),
+        done_reading(false), failed(false), out(out) {}
+
+  // reader side of the isomer queue, blocks while the queue is full
+  // returns false if the pipeline has failed. F is moved into the queue and
+  // replaced by an isomer that has been written out, if there is one, so that
+  // reading into it reuses its vectors instead of allocating new ones
+  bool push(Fullerene(&F)) {
+    unique_lock<mutex> lock(m);
+    not_full.wait(lock,
+                  [&] { return failed || (int)queue.size() < capacity; });
+    if (failed)
+      return false;
+    queue.push_back(move(F));
+    if (!free_list.empty()) {
+      F = move(free_list.back());
+      free_list.pop_back();
+    }
+    not_empty.notify_one();
+    return true;
+  }
+
+  // worker side of the isomer queue, takes up to max_size isomers in the
+  // order they were read. Blocks while the queue is empty, returns false once
+  // there is nothing left to solve
+  bool pop(vector<Fullerene>(&batch), const int max_size) {
+    unique_lock<mutex> lock(m);
+    not_empty.wait(lock,
+                   [&] { return failed || done_reading || !queue.empty(); });
+    if (failed || queue.empty())
+      return false;
+    batch.clear();
+    while (!queue.empty() && (int)batch.size() < max_size) {
+      batch.push_back(move(queue.front()));
+      queue.pop_front();
+    }
+    not_full.notify_all();
+    return true;
+  }
+
+  void close() {
+    lock_guard<mutex> lock(m);
+    done_reading = true;
+    not_empty.notify_all();
+  }
+
+  // hand the rows of isomer F to the reorder buffer and write out every row
+  // that is now next in line. To bound the reorder buffer, a worker that is
+  // too far ahead of the next row to be written waits here. Row k * NFILE + i
+  // belongs to out file i of the kth value of p. F is moved into the buffer,
+  // and once written out onto the free list for the reader
+  void commit(Fullerene(&F), vector<string>(&rows)) {
+    unique_lock<mutex> lock(m);
+    const int id = F.id;
+    written.wait(lock, [&] { return failed || id < next_write + capacity; });
+    if (failed)
+      return;
+    pending[id] = make_pair(move(F), move(rows));
+    auto it = pending.begin();
+    while (it != pending.end() && it->first == next_write) {
+      const vector<string> &isomer_rows = it->second.second;
+      for (size_t k = 0; k < opts.p_vals.size(); k++) {
+        for (int i = 0; i < NFILE; i++) {
+          if (opts.to_stdout) {
+            cout << isomer_rows[k * NFILE + i];
+          } else {
+            out.files[k][i] << isomer_rows[k * NFILE + i];
+          }
+        }
+      }
+      next_write++;
+      // the offset of the input after the isomer
+      const size_t offset = it->second.first.offset;
+      if (opts.checkpoint_every && next_write % opts.checkpoint_every == 0)
+        save_checkpoint(opts, out, next_write, offset);
+      log.add(it->second.first);
+      free_list.push_back(move(it->second.first));
+      it = pending.erase(it);
+    }
+    // the next filter gets the rows as soon as they are ready
+    if (opts.to_stdout)
+      cout.flush();
+    written.notify_all();
+  }
+
+  // add the counts of a worker to those of the run
+  void add_stats(const Run_stats(&worker_stats)) {
+    lock_guard<mutex> lock(m);
+    stats.num_solves += worker_stats.num_solves;
+    stats.num_by_bound += worker_stats.num_by_bound;
+  }
+
+  // id of the next isomer to be written out
+  int get_next_write() {
+    lock_guard<mutex> lock(m);
+    return next_write;
+  }
+
+  // record the first error and wake everyone up so the threads can exit
+  void fail(exception_ptr e) {
+    lock_guard<mutex> lock(m);
+    if (!failed) {
+      failed = true;
+      error = e;
+    }
+    not_full.notify_all();
+    not_empty.notify_all();
+    written.notify_all();
+  }
+
+  void rethrow() {
+    if (error)
+      rethrow_exception(error);
+  }
+
+  const Options &opts;
+  Input &in;
+  Clar_cache &cache;
+  Stats_log &log;
+  const int first_id;
+  Run_stats stats;
+
+private:
+  const int capacity;
+  int next_write;
+  bool done_reading, failed;
+  exception_ptr error;
+  deque<Fullerene> queue;
+  map<int, pair<Fullerene, vector<string>>> pending;
+  // isomers that have been written out, there are at most as many as can be
+  // in the queue and the reorder buffer at once
+  vector<Fullerene> free_list;
+  Out_files &out;
+  mutex m;
+  condition_variable not_full, not_empty, written;
+};
+
+void read_isomers(Pipeline(&pipe)) {
+  try {
+    Fullerene F;
+    int graph_num = pipe.first_id;
+    Clock::time_point start = Clock::now();
+    // while there are isomers to read in
+    while (read_fullerene(pipe.in, F, pipe.opts.p_vals[0])) {
+      F.id = graph_num++;
+      F.offset = pipe.in.offset();
+      F.stats = Isomer_stats();
+      F.stats.read_us = lap_us(start);
+      if (!pipe.push(F))
+        return;
+      // waiting on a full queue is not reading
+      start = Clock::now();
+    }
+  } catch (...) {
+    pipe.fail(current_exception());
+  }
+  pipe.close();
+}
+
+void solve_isomers(Pipeline(&pipe)) {
+  try {
+    // each worker owns its environment, the models are too small for Gurobi
+    // to make use of more than one thread per worker
+    GRBEnv grb_env = GRBEnv(true);
+    if (pipe.opts.engine == GUROBI && !pipe.opts.heuristic_only) {
+      grb_env.set(GRB_IntParam_OutputFlag, DEBUG_GUROBI);
+      if (pipe.opts.num_threads > 1)
+        grb_env.set(GRB_IntParam_Threads, 1);
+      try {
+        grb_env.start();
+      } catch (const GRBException &e) {
+        throw runtime_error("\nError: could not start Gurobi environment"
+                            "\nCode: " +
+                            to_string(e.getErrorCode()) +
+                            "\nMessage: " + e.getMessage());
+      }
+    }
+
+    // each isomer of a batch writes to its own buffers
+    const int num_p = pipe.opts.p_vals.size(), size = pipe.opts.batch_size;
+    vector<Fullerene> batch;
+    vector<ostringstream> out_bufs(size * num_p * NFILE);
+    vector<vector<Out_ptrs>> out_files_ptr(size, vector<Out_ptrs>(num_p));
+    for (int j = 0; j < size; j++) {
+      for (int k = 0; k < num_p; k++) {
+        for (int i = 0; i < NFILE; i++) {
+          out_files_ptr[j][k][i] = &out_bufs[(j * num_p + k) * NFILE + i];
+        }
+      }
+    }
+    vector<string> rows;
+    Run_stats stats;
+    while (pipe.pop(batch, size)) {
+      solve_batch(batch, pipe.opts, grb_env, pipe.cache, out_files_ptr, stats);
+      for (size_t j = 0; j < batch.size(); j++) {
+        rows.resize(num_p * NFILE);
+        for (int i = 0; i < num_p * NFILE; i++) {
+          rows[i] = out_bufs[j * num_p * NFILE + i].str();
+          out_bufs[j * num_p * NFILE + i].str("");
+        }
+        pipe.commit(batch[j], rows);
+      }
+    }
+    pipe.add_stats(stats);
+  } catch (const GRBException &e) {
+    // any other Gurobi error a solver did not report itself
+    const string msg = "\nError: Gurobi error\nCode: " +
+                       to_string(e.getErrorCode()) +
+                       "\nMessage: " + e.getMessage();
+    pipe.fail(make_exception_ptr(runtime_error(msg)));
+  } catch (...) {
+    pipe.fail(current_exception());
+  }
+}
+
+int run_pipeline(const Options(&opts), Input(&in), Out_files(&out),
+                 Clar_cache(&cache), Stats_log(&log), const int first_id,
+                 Run_stats(&stats)) {
+  // one reader feeds a bounded queue of isomers to the workers, whose rows
+  // are written out in the order the isomers were read in
+  Pipeline pipe(opts, in, out, cache, log, first_id);
+  thread reader(read_isomers, ref(pipe));
+  vector<thread> workers;
+  for (int i = 0; i < opts.num_threads; i++) {
+    workers.emplace_back(solve_isomers, ref(pipe));
+  }
+  reader.join();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  pipe.rethrow();
+  stats = pipe.stats;
+  return pipe.get_next_write();
+}
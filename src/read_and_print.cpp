@@ -1,4 +1,6 @@
 #include "include.h"
+#include <algorithm>
+#include <sstream>
 
 // For error reporting
 void throw_error(const int n, const int p, const int graph_id,
@@ -7,12 +9,66 @@ void throw_error(const int n, const int p, const int graph_id,
                       ", graph num = " + to_string(graph_id) + error_message);
 }
 
+// read in fullerene graph given in buckygen's binary planar_code format.
+// Vertices are numbered from 1 and each vertex lists its neighbours in
+// clockwise order followed by a 0
+bool read_planar_code(Input(&in), Fullerene(&F), const int p) {
+  unsigned n, entry;
+  // read in number of vertices of isomer
+  if (!in.next_entry(n, false))
+    return false;
+  // a first byte of 0 means that n and every entry after it take 2 bytes
+  const bool wide = n == 0;
+  if (wide && !in.next_entry(n, true))
+    throw_error(F.n, p, F.id, "\nFailed reading number of vertices");
+  // check that number of vertices is valid
+  // n should be an even number at least 20 and not equal to 22
+  if (n < 20 || n == 22 || n % 2 != 0) {
+    throw_error(F.n, p, F.id, "\nInvalid fullerene size " + to_string(n));
+  }
+  // resize the fullerene
+  F.Resize(n);
+  // for each vertex in the graph
+  for (int i = 0; i < (int)n; i++) {
+    int degree = 0;
+    while (true) {
+      if (!in.next_entry(entry, wide)) {
+        const string msg = "\nFailed reading neighbour " + to_string(degree) +
+                           " of vertex " + to_string(i);
+        throw_error(F.n, p, F.id, msg);
+      }
+      if (entry == 0)
+        break;
+      if (entry > n) {
+        const string msg = "\nVertex " + to_string(i) +
+                           " has invalid neighbour: " + to_string(entry - 1);
+        throw_error(F.n, p, F.id, msg);
+      }
+      // keep the clockwise order, counter_clockwise_walk relies on it
+      if (degree < 3) {
+        F.primal[i].adj_v[degree] = entry - 1;
+        F.primal[i].faces[degree] = -1;
+      }
+      degree++;
+    }
+    // check vertex degree
+    if (degree != 3) {
+      const string msg = "\nVertex " + to_string(i) +
+                         " has invalid degree: " + to_string(degree);
+      throw_error(F.n, p, F.id, msg);
+    }
+  }
+  return true;
+}
+
 // read in fullerene graph and populate some default values into the
 // data structure
-bool read_fullerene(Fullerene(&F), const int p) {
+bool read_fullerene(Input(&in), Fullerene(&F), const int p) {
+  if (in.format() == PLANAR_CODE)
+    return read_planar_code(in, F, p);
   int degree, n;
   // read in number of vertices of isomer
-  if (!(cin >> n))
+  if (!in.next_int(n))
     return false;
   // check that number of vertices is valid
   // n should be an even number at least 20 and not equal to 22
@@ -24,7 +80,7 @@ bool read_fullerene(Fullerene(&F), const int p) {
   // for each vertex in the graph
   for (int i = 0; i < n; i++) {
     // read in degree of vertex i
-    if (!(cin >> degree)) {
+    if (!in.next_int(degree)) {
       throw_error(F.n, p, F.id,
                   "\nFailed reading vertex " + to_string(i) + "'s degree");
     }
@@ -37,7 +93,7 @@ bool read_fullerene(Fullerene(&F), const int p) {
     // for each neighbour of i
     for (int j = 0; j < 3; j++) {
       // update adjacency list of vertex i
-      if (!(cin >> F.primal[i].adj_v[j])) {
+      if (!in.next_int(F.primal[i].adj_v[j])) {
         const string msg = "\nFailed reading neighbour " + to_string(j) +
                            " of vertex " + to_string(i);
         throw_error(F.n, p, F.id, msg);
@@ -50,7 +106,7 @@ bool read_fullerene(Fullerene(&F), const int p) {
   return true;
 }
 
-void print_primal(const int n, const vector<vertex> primal) {
+void print_primal(const int n, const vector<vertex>(&primal)) {
   cout << "Primal graph" << endl;
   cout << "Vert:  Neighbours         Faces           Edges" << endl;
   for (int i = 0; i < n; i++) {
@@ -72,7 +128,7 @@ void print_primal(const int n, const vector<vertex> primal) {
   }
 }
 
-void print_dual(const int dual_n, const vector<face> dual) {
+void print_dual(const int dual_n, const vector<face>(&dual)) {
   cout << "Dual graph" << endl << "Face:       Neighbours" << endl;
   for (int i = 0; i < dual_n; i++) {
     cout << setw(4) << i << ": ";
@@ -84,7 +140,7 @@ void print_dual(const int dual_n, const vector<face> dual) {
 }
 
 void print_sol(const Fullerene(&F), const int num_res_faces,
-               const vector<GRBVar> fvars, const vector<GRBVar> evars) {
+               const Clar_sol(&sol)) {
   cout << endl
        << "n = " << F.n << ", graph num = " << F.id << endl
        << "Solution summary:" << endl;
@@ -96,13 +152,13 @@ void print_sol(const Fullerene(&F), const int num_res_faces,
   cout << "Num resonant faces: " << num_res_faces << endl;
   cout << "Resonant face ids: ";
   for (int i = 0; i < F.dual_n; i++) {
-    if (fvars[i].get(GRB_DoubleAttr_X) < 0.99)
+    if (!sol.res_face[i])
       continue;
     cout << i << " ";
   }
   cout << endl << "Matching edges: ";
   for (int i = 0; i < F.num_edges; i++) {
-    if (evars[i].get(GRB_DoubleAttr_X) < 0.99)
+    if (!sol.match_e[i])
       continue;
     cout << "(" << F.edges[i].vertices[0] << "," << F.edges[i].vertices[1]
          << ") ";
@@ -111,41 +167,201 @@ void print_sol(const Fullerene(&F), const int num_res_faces,
 }
 
 void save_sol(const Fullerene(&F), const int p, const int num_res_faces,
-              const vector<GRBVar> fvars, const vector<GRBVar> evars,
-              ofstream out_files_ptr[NFILE]) {
+              const Clar_sol(&sol), ostream *out_files_ptr[NFILE]) {
   // if there is no solution
   if (num_res_faces == 0) {
-    out_files_ptr[0] << 0 << endl;
-    out_files_ptr[1] << 0 << endl;
-    out_files_ptr[2] << 0 << endl;
-    out_files_ptr[3] << 0 << endl;
+    *out_files_ptr[0] << 0 << endl;
+    *out_files_ptr[1] << 0 << endl;
+    *out_files_ptr[2] << 0 << endl;
+    *out_files_ptr[3] << 0 << endl;
     return;
   }
   // number of resonant faces
-  out_files_ptr[0] << num_res_faces << endl;
+  *out_files_ptr[0] << num_res_faces << endl;
   // print resonant faces
-  out_files_ptr[1] << p;
-  out_files_ptr[2] << num_res_faces - p;
-  for (int i = 0; i < F.dual_n; i++) {
-    if (fvars[i].get(GRB_DoubleAttr_X) < 0.99)
-      continue;
-    if (F.dual[i].size == 5) {
-      out_files_ptr[1] << " " << i;
-    } else {
-      out_files_ptr[2] << " " << i;
-    }
+  *out_files_ptr[1] << p;
+  for (int f : F.pents) {
+    if (sol.res_face[f])
+      *out_files_ptr[1] << " " << f;
   }
-  out_files_ptr[1] << endl;
-  out_files_ptr[2] << endl;
+  *out_files_ptr[2] << num_res_faces - p;
+  for (int f : F.hexes) {
+    if (sol.res_face[f])
+      *out_files_ptr[2] << " " << f;
+  }
+  *out_files_ptr[1] << endl;
+  *out_files_ptr[2] << endl;
   // matching edges
-  out_files_ptr[3] << F.n - 6 * (num_res_faces - p) - 5 * p;
+  *out_files_ptr[3] << F.n - 6 * (num_res_faces - p) - 5 * p;
   for (int i = 0; i < F.num_edges; i++) {
-    if (evars[i].get(GRB_DoubleAttr_X) < 0.99)
+    if (!sol.match_e[i])
       continue;
-    out_files_ptr[3] << " " << F.edges[i].vertices[0] << " "
+    *out_files_ptr[3] << " " << F.edges[i].vertices[0] << " "
                      << F.edges[i].vertices[1];
   }
-  out_files_ptr[3] << endl;
+  *out_files_ptr[3] << endl;
+}
+
+// write an unsigned 16 bit value, little endian
+void put_u16(ostream(&out), const int val) {
+  out.put((char)(val & 0xff));
+  out.put((char)((val >> 8) & 0xff));
+}
+
+bool get_u16(istream(&in), int(&val)) {
+  unsigned char bytes[2];
+  if (!in.read((char *)bytes, 2))
+    return false;
+  val = bytes[0] | (bytes[1] << 8);
+  return true;
+}
+
+// write a set of len ids as a bitset, bit i is bit i % 8 of byte i / 8. An
+// empty set (no structure) is written as all 0
+void put_bits(ostream(&out), const Bitset(&bits), const int len) {
+  for (int b = 0; 8 * b < len; b++) {
+    out.put((char)(bits.empty() ? 0 : bits.byte(b)));
+  }
+}
+
+bool get_bits(istream(&in), Bitset(&bits), const int len) {
+  bits.assign(len);
+  for (int b = 0; 8 * b < len; b++) {
+    const int byte = in.get();
+    if (byte == EOF)
+      return false;
+    bits.set_byte(b, byte);
+  }
+  return true;
+}
+
+// One record per isomer: n and the number of resonant faces (2 bytes each),
+// then the resonant faces as a bitset over the face ids and the matching
+// edges as a bitset over the edge ids
+void save_sol_bin(const Fullerene(&F), const int num_res_faces,
+                  const Clar_sol(&sol), ostream(&out)) {
+  put_u16(out, F.n);
+  put_u16(out, num_res_faces);
+  put_bits(out, sol.res_face, F.dual_n);
+  put_bits(out, sol.match_e, F.num_edges);
+}
+
+// read the record of isomer F, returns false if there are no records left
+bool read_sol_bin(istream(&in), const Fullerene(&F), int(&num_res_faces),
+                  Clar_sol(&sol)) {
+  int n;
+  if (!get_u16(in, n))
+    return false;
+  if (n != F.n) {
+    throw_error(F.n, 0, F.id,
+                "\nBinary record is for an isomer on " + to_string(n) +
+                    " vertices");
+  }
+  if (!get_u16(in, num_res_faces) || !get_bits(in, sol.res_face, F.dual_n) ||
+      !get_bits(in, sol.match_e, F.num_edges)) {
+    throw_error(F.n, 0, F.id, "\nBinary record is cut short");
+  }
+  return true;
+}
+
+// The number of face sets and of Clar structures, and if list is true a row
+// of the face sets, each a comma separated list of face ids
+void save_clar_count(const Clar_count(&count), const bool list,
+                     ostream *out_files_ptr[NFILE]) {
+  *out_files_ptr[COUNT_FILE] << count.num_face_sets << " "
+                             << count.num_structures << endl;
+  if (!list)
+    return;
+  *out_files_ptr[FACES_FILE] << count.face_sets.size();
+  for (const vector<int> &faces : count.face_sets) {
+    for (size_t i = 0; i < faces.size(); i++) {
+      *out_files_ptr[FACES_FILE] << (i == 0 ? " " : ",") << faces[i];
+    }
+  }
+  *out_files_ptr[FACES_FILE] << endl;
+}
+
+void write_sol(const Fullerene(&F), const Options(&opts), const int p,
+               const int num_res_faces, const Clar_sol(&sol),
+               ostream *out_files_ptr[NFILE]) {
+  Clock::time_point start = Clock::now();
+  if (opts.binary_out) {
+    save_sol_bin(F, num_res_faces, sol, *out_files_ptr[0]);
+  } else if (opts.to_stdout) {
+    // one line per isomer and value of p, the rows of the four out files
+    // after the id of the isomer and p
+    ostringstream rows[4];
+    ostream *rows_ptr[NFILE] = {&rows[0], &rows[1], &rows[2], &rows[3]};
+    save_sol(F, p, num_res_faces, sol, rows_ptr);
+    string line = rows[0].str() + rows[1].str() + rows[2].str() + rows[3].str();
+    replace(line.begin(), line.end() - 1, '\n', ' ');
+    *out_files_ptr[0] << F.id << " " << p << " " << line;
+  } else {
+    save_sol(F, p, num_res_faces, sol, out_files_ptr);
+  }
+  F.stats.write_us += lap_us(start);
+}
+
+void open_bin_file(const int p, const string suffix, string(&name),
+                   ofstream(&out_file)) {
+  name = "output/pp_clar_sol.bin" + suffix;
+  get_out_name(p, name);
+  // new files get a header
+  ifstream existing(name, ios::binary | ios::ate);
+  const bool is_new = !existing.is_open() || existing.tellg() == 0;
+  existing.close();
+  out_file.open(name, ios::app | ios::binary);
+  if (!out_file.is_open()) {
+    throw runtime_error("\nError: Could not open file " + name);
+  }
+  if (is_new) {
+    out_file << BIN_HEADER;
+    out_file.put((char)p);
+  }
+}
+
+void bin_to_text(const string bin_name, Input(&in)) {
+  ifstream bin_file(bin_name, ios::binary);
+  if (!bin_file.is_open()) {
+    throw runtime_error("\nError: Could not open file " + bin_name);
+  }
+  string header(BIN_HEADER.size(), ' ');
+  bin_file.read(&header[0], header.size());
+  const int p = bin_file.get();
+  if (!bin_file || header != BIN_HEADER) {
+    throw runtime_error("\nError: " + bin_name + " is not a binary out file");
+  }
+  string out_file_names[NFILE] = {"output/pp_anionic_clar_num",
+                                  "output/pp_r_pent", "output/pp_r_hex",
+                                  "output/pp_match_e"};
+  ofstream out_files[NFILE];
+  ostream *out_files_ptr[NFILE];
+  open_out_file(p, out_file_names, out_files);
+  get_out_ptrs(out_files, out_files_ptr);
+
+  // the records are in the order of the isomers they were solved from
+  Fullerene F;
+  Clar_sol sol;
+  int num_res_faces, graph_num = 0;
+  while (read_fullerene(in, F, p)) {
+    F.id = graph_num++;
+    construct_planar_dual(F, p);
+    if (!read_sol_bin(bin_file, F, num_res_faces, sol))
+      throw_error(F.n, p, F.id, "\nNo binary record for isomer");
+    save_sol(F, p, num_res_faces, sol, out_files_ptr);
+  }
+  if (bin_file.peek() != EOF) {
+    throw runtime_error("\nError: " + bin_name +
+                        " has more records than there are isomers");
+  }
+  close_files(out_files);
+}
+
+// the out files of a shard end in .i_of_k, e.g. output/02_r_hex.3_of_16
+string shard_suffix(const Options(&opts)) {
+  if (opts.num_shards == 1)
+    return "";
+  return "." + to_string(opts.shard) + "_of_" + to_string(opts.num_shards);
 }
 
 void get_out_name(const int p, string &fname) {
@@ -161,6 +377,9 @@ void get_out_name(const int p, string &fname) {
 void open_out_file(const int p, string (&out_file_names)[NFILE],
                    ofstream out_files_ptr[NFILE]) {
   for (int i = 0; i < NFILE; i++) {
+    // the files without a name are not used
+    if (out_file_names[i].empty())
+      continue;
     get_out_name(p, out_file_names[i]);
     out_files_ptr[i].open(out_file_names[i], ios::app);
     if (!out_files_ptr[i].is_open()) {
@@ -174,3 +393,74 @@ void close_files(ofstream out_files_ptr[NFILE]) {
     out_files_ptr[i].close();
   }
 }
+
+void get_out_ptrs(ofstream out_files[NFILE], ostream *out_files_ptr[NFILE]) {
+  // the solvers write through generic streams so that the same code can write
+  // to files or to in-memory buffers
+  for (int i = 0; i < NFILE; i++) {
+    out_files_ptr[i] = &out_files[i];
+  }
+}
+
+// open an out file that is only written with some of the options
+void open_extra_file(const int p, const string base, string(&name),
+                     ofstream(&out_file)) {
+  name = base;
+  get_out_name(p, name);
+  out_file.open(name, ios::app);
+  if (!out_file.is_open()) {
+    throw runtime_error("\nError: Could not open file " + name);
+  }
+}
+
+void open_out_files(const Options(&opts), Out_files(&out)) {
+  const int num_p = opts.p_vals.size();
+  const string suffix = shard_suffix(opts);
+  out.files = vector<array<ofstream, NFILE>>(num_p);
+  out.names.assign(num_p, array<string, NFILE>());
+  // the rows go to stdout, a binary stream gets its header here
+  if (opts.to_stdout) {
+    if (opts.binary_out) {
+      cout << BIN_HEADER;
+      cout.put((char)opts.p_vals[0]);
+    }
+    return;
+  }
+  for (int k = 0; k < num_p; k++) {
+    if (opts.binary_out) {
+      // only the first out file is used
+      open_bin_file(opts.p_vals[k], suffix, out.names[k][0], out.files[k][0]);
+    } else {
+      string out_file_names[NFILE] = {"output/pp_anionic_clar_num",
+                                      "output/pp_r_pent", "output/pp_r_hex",
+                                      "output/pp_match_e"};
+      for (int i = 0; i < AUT_FILE; i++) {
+        out_file_names[i] += suffix;
+      }
+      open_out_file(opts.p_vals[k], out_file_names, out.files[k].data());
+      copy(out_file_names, out_file_names + NFILE, out.names[k].begin());
+    }
+    if (opts.symmetry) {
+      open_extra_file(opts.p_vals[k], "output/pp_aut_order" + suffix,
+                      out.names[k][AUT_FILE], out.files[k][AUT_FILE]);
+    }
+    if (opts.count_structures) {
+      open_extra_file(opts.p_vals[k], "output/pp_clar_count" + suffix,
+                      out.names[k][COUNT_FILE], out.files[k][COUNT_FILE]);
+    }
+    if (opts.list_structures) {
+      open_extra_file(opts.p_vals[k], "output/pp_clar_faces" + suffix,
+                      out.names[k][FACES_FILE], out.files[k][FACES_FILE]);
+    }
+    if (opts.screen) {
+      open_extra_file(opts.p_vals[k], "output/pp_bounds" + suffix,
+                      out.names[k][BOUNDS_FILE], out.files[k][BOUNDS_FILE]);
+    }
+  }
+}
+
+void close_out_files(Out_files(&out)) {
+  for (auto &files : out.files) {
+    close_files(files.data());
+  }
+}
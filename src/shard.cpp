@@ -0,0 +1,235 @@
+#include "include.h"
+#include <unistd.h>
+
+// A run can be split into shards, e.g. one per node of a cluster. Shard i of
+// k solves the ith of k blocks of consecutive isomers, found from the offset
+// index of the input, and writes to out files of its own. Once it is done it
+// records the ids of its block, and the shards are merged by concatenating
+// their out files in the order of the blocks.
+
+// the range file of a shard, output/pp_shard.i_of_k
+string range_name(const Options(&opts)) {
+  string name = "output/pp_shard" + shard_suffix(opts);
+  get_out_name(opts.p_vals[0], name);
+  return name;
+}
+
+// The index file of an input holds a header, the size of the input and the
+// number of isomers, then the byte offset of each isomer, all 8 bytes little
+// endian. A shard reads the number and its own two offsets, so it neither
+// reads the rest of the index nor parses the isomers of the other shards
+const string INDEX_HEADER = ">>clar_index<<";
+
+void put_u64(ostream(&out), const uint64_t val) {
+  for (int b = 0; b < 8; b++) {
+    out.put((char)((val >> (8 * b)) & 0xff));
+  }
+}
+
+bool get_u64(istream(&in), uint64_t(&val)) {
+  unsigned char bytes[8];
+  if (!in.read((char *)bytes, 8))
+    return false;
+  val = 0;
+  for (int b = 7; b >= 0; b--) {
+    val = (val << 8) | bytes[b];
+  }
+  return true;
+}
+
+// Write the offsets of the isomers of the input to the index file. It is
+// written to a temporary file and renamed, so shards that start together can
+// each write it without one of them reading half an index
+void save_index(const string name, const size_t input_size,
+                const vector<size_t>(&offsets)) {
+  const string tmp_name = name + ".tmp" + to_string(getpid());
+  ofstream tmp(tmp_name, ios::trunc | ios::binary);
+  if (!tmp.is_open()) {
+    throw runtime_error("\nError: Could not open file " + tmp_name);
+  }
+  tmp << INDEX_HEADER;
+  put_u64(tmp, input_size);
+  put_u64(tmp, offsets.size());
+  for (size_t off : offsets) {
+    put_u64(tmp, off);
+  }
+  tmp.close();
+  if (!tmp) {
+    throw runtime_error("\nError: Could not write file " + tmp_name);
+  }
+  if (rename(tmp_name.c_str(), name.c_str()) != 0) {
+    throw runtime_error("\nError: Could not rename " + tmp_name + " to " +
+                        name);
+  }
+}
+
+// the offset of isomer id in the index file, or the end of the input past
+// the last isomer
+size_t read_offset(ifstream(&file), const string name, const long id,
+                   const long num, const size_t input_size) {
+  if (id == num)
+    return input_size;
+  uint64_t off;
+  file.seekg(INDEX_HEADER.size() + 8 * (2 + id));
+  if (!get_u64(file, off) || off > input_size) {
+    throw runtime_error("\nError: Invalid offset of isomer " + to_string(id) +
+                        " in index " + name);
+  }
+  return off;
+}
+
+// Find the block of the shard from the index file, returns false if there is
+// no index file yet
+bool read_index(const Options(&opts), const size_t input_size,
+                int(&first_id), int(&end_id), size_t(&first_off),
+                size_t(&end_off)) {
+  const string &name = opts.index_file;
+  ifstream file(name, ios::binary);
+  if (!file.is_open())
+    return false;
+  string header(INDEX_HEADER.size(), ' ');
+  file.read(&header[0], header.size());
+  uint64_t size, num;
+  if (!file || header != INDEX_HEADER || !get_u64(file, size) ||
+      !get_u64(file, num)) {
+    throw runtime_error("\nError: " + name + " is not an index file");
+  }
+  if (size != input_size) {
+    throw runtime_error("\nError: " + name + " is the index of another "
+                        "input, of " + to_string(size) + " bytes");
+  }
+  first_id = num * opts.shard / opts.num_shards;
+  end_id = num * (opts.shard + 1) / opts.num_shards;
+  first_off = read_offset(file, name, first_id, num, input_size);
+  end_off = read_offset(file, name, end_id, num, input_size);
+  return true;
+}
+
+// Limit the input to the block of the shard, the isomers first_id to
+// end_id - 1. The blocks of the shards differ in size by at most one isomer.
+// Without an index file the whole input is indexed first, and the index is
+// saved if the file is named
+void shard_input(const Options(&opts), Input(&in), int(&first_id),
+                 int(&end_id)) {
+  if (!in.is_mapped()) {
+    throw runtime_error("\nError: --shard needs the isomers in a file, "
+                        "redirect it to stdin");
+  }
+  const size_t input_size = in.size();
+  size_t first_off, end_off;
+  if (opts.index_file.empty() ||
+      !read_index(opts, input_size, first_id, end_id, first_off, end_off)) {
+    const vector<size_t> offsets = in.index_isomers();
+    if (!opts.index_file.empty())
+      save_index(opts.index_file, input_size, offsets);
+    const long num = offsets.size();
+    first_id = num * opts.shard / opts.num_shards;
+    end_id = num * (opts.shard + 1) / opts.num_shards;
+    first_off = first_id < num ? offsets[first_id] : input_size;
+    end_off = end_id < num ? offsets[end_id] : input_size;
+  }
+  if (first_off > end_off) {
+    throw runtime_error("\nError: The offsets of the isomers in " +
+                        opts.index_file + " are out of order");
+  }
+  in.limit(end_off);
+  in.seek(first_off);
+}
+
+// index the whole input into opts.index_file, for the shards to share
+void index_input(const Options(&opts), Input(&in)) {
+  if (!in.is_mapped()) {
+    throw runtime_error("\nError: --index needs the isomers in a file, "
+                        "redirect it to stdin");
+  }
+  save_index(opts.index_file, in.size(), in.index_isomers());
+}
+
+// record that the shard has written out every isomer of its block
+void save_shard_range(const Options(&opts), const int first_id,
+                      const int end_id) {
+  const string name = range_name(opts);
+  ofstream file(name, ios::trunc);
+  file << first_id << " " << end_id << endl;
+  file.close();
+  if (!file) {
+    throw runtime_error("\nError: Could not write file " + name);
+  }
+}
+
+// Concatenate out file name of every shard into name, skipping the first
+// header bytes of all but the first shard. Returns false if the first shard
+// has no such file, e.g. the binary file of a run with text out files
+bool merge_file(const Options(&opts), const string name, const size_t header) {
+  Options shard_opts = opts;
+  shard_opts.num_shards = opts.merge_shards;
+  shard_opts.shard = 0;
+  if (!ifstream(name + shard_suffix(shard_opts)).is_open())
+    return false;
+  // a merge does not add to the out files of another run
+  ifstream existing(name, ios::ate);
+  if (existing.is_open() && existing.tellg() > 0) {
+    throw runtime_error("\nError: " + name + " is not empty, the shards are "
+                        "not merged into it");
+  }
+  ofstream out(name, ios::trunc | ios::binary);
+  if (!out.is_open()) {
+    throw runtime_error("\nError: Could not open file " + name);
+  }
+  for (int s = 0; s < opts.merge_shards; s++) {
+    shard_opts.shard = s;
+    const string shard_name = name + shard_suffix(shard_opts);
+    ifstream in(shard_name, ios::binary);
+    if (!in.is_open()) {
+      throw runtime_error("\nError: Could not open file " + shard_name);
+    }
+    if (s > 0)
+      in.ignore(header);
+    // copying nothing would set the fail bit of out
+    if (in.peek() != EOF)
+      out << in.rdbuf();
+  }
+  out.close();
+  if (!out) {
+    throw runtime_error("\nError: Could not write file " + name);
+  }
+  return true;
+}
+
+// merge the out files of opts.merge_shards shards, each of which has to have
+// finished its block
+void merge_shards(const Options(&opts)) {
+  Options shard_opts = opts;
+  shard_opts.num_shards = opts.merge_shards;
+  int next_id = 0;
+  for (int s = 0; s < opts.merge_shards; s++) {
+    shard_opts.shard = s;
+    const string name = range_name(shard_opts);
+    ifstream file(name);
+    int first_id, end_id;
+    if (!(file >> first_id >> end_id)) {
+      throw runtime_error("\nError: Shard " + to_string(s) +
+                          " has not finished, there is no " + name);
+    }
+    if (first_id != next_id) {
+      throw runtime_error("\nError: Shard " + to_string(s) +
+                          " starts at isomer " + to_string(first_id) +
+                          " instead of " + to_string(next_id));
+    }
+    next_id = end_id;
+  }
+  const string text_names[] = {"output/pp_anionic_clar_num",
+                               "output/pp_r_pent", "output/pp_r_hex",
+                               "output/pp_match_e", "output/pp_aut_order",
+                               "output/pp_clar_count",
+                               "output/pp_clar_faces", "output/pp_bounds"};
+  for (int p : opts.p_vals) {
+    for (string name : text_names) {
+      get_out_name(p, name);
+      merge_file(opts, name, 0);
+    }
+    string name = "output/pp_clar_sol.bin";
+    get_out_name(p, name);
+    merge_file(opts, name, BIN_HEADER.size() + 1);
+  }
+}
@@ -0,0 +1,118 @@
+#include "include.h"
+#include <algorithm>
+
+// position of u in the neighbourhood of v
+int adj_position(const Fullerene(&F), const int v, const int u) {
+  for (int i = 0; i < 3; i++) {
+    if (F.primal[v].adj_v[i] == u)
+      return i;
+  }
+  return -1;
+}
+
+// Try to extend the map sending vertex 0 to v and the neighbour in position i
+// of 0 to the neighbour in position (r + dir * i) % 3 of v. dir is 1 if the
+// map keeps the clockwise order of the neighbours and 2 if it reverses it.
+// The rotation system then fixes the image of every other vertex, which is
+// found by a breadth first search. Returns false if the map is not an
+// automorphism
+bool extend_map(const Fullerene(&F), const int v, const int r, const int dir,
+                vector<int>(&image), vector<int>(&rot), vector<int>(&queue),
+                vector<char>(&used)) {
+  for (int x = 0; x < F.n; x++) {
+    image[x] = -1;
+    used[x] = 0;
+  }
+  int head = 0, tail = 0;
+  image[0] = v;
+  rot[0] = r;
+  used[v] = 1;
+  queue[tail++] = 0;
+  while (head < tail) {
+    const int x = queue[head++], y = image[x];
+    for (int i = 0; i < 3; i++) {
+      const int u = F.primal[x].adj_v[i];
+      const int w = F.primal[y].adj_v[(rot[x] + dir * i) % 3];
+      if (image[u] != -1) {
+        if (image[u] != w)
+          return false;
+        continue;
+      }
+      if (used[w])
+        return false;
+      // the edge from u back to x is where the rotation at u is anchored
+      const int iu = adj_position(F, u, x), iy = adj_position(F, w, y);
+      image[u] = w;
+      rot[u] = (iy + (3 - dir) * iu) % 3;
+      used[w] = 1;
+      queue[tail++] = u;
+    }
+  }
+  return true;
+}
+
+// the face of F whose boundary has the consecutive vertices a, b and c
+int face_through(const Fullerene(&F), const int a, const int b, const int c) {
+  for (int j = 0; j < 3; j++) {
+    const face &g = F.dual[F.primal[b].faces[j]];
+    bool has_a = false, has_c = false;
+    for (int k = 0; k < g.size; k++) {
+      has_a |= g.vertices[k] == a;
+      has_c |= g.vertices[k] == c;
+    }
+    if (has_a && has_c)
+      return F.primal[b].faces[j];
+  }
+  throw runtime_error("\nNo face through vertices " + to_string(a) + ", " +
+                      to_string(b) + " and " + to_string(c));
+}
+
+void automorphisms(const Fullerene(&F), vector<vector<int>>(&aut_faces)) {
+  aut_faces.clear();
+  vector<int> image(F.n), rot(F.n), queue(F.n);
+  vector<char> used(F.n);
+  // an automorphism of the embedding is fixed by where it sends vertex 0, its
+  // first neighbour and the orientation, so there are at most 6n of them and
+  // each is checked in O(n)
+  for (int v = 0; v < F.n; v++) {
+    for (int r = 0; r < 3; r++) {
+      for (int dir = 1; dir <= 2; dir++) {
+        if (!extend_map(F, v, r, dir, image, rot, queue, used))
+          continue;
+        // the image of a face is the face through the images of three of
+        // its consecutive vertices
+        vector<int> perm(F.dual_n);
+        for (int f = 0; f < F.dual_n; f++) {
+          const int *vertices = F.dual[f].vertices;
+          perm[f] = face_through(F, image[vertices[0]], image[vertices[1]],
+                                 image[vertices[2]]);
+        }
+        aut_faces.push_back(perm);
+      }
+    }
+  }
+}
+
+int largest_face_orbit(const Fullerene(&F), vector<int>(&orbit)) {
+  orbit.clear();
+  vector<char> seen(F.dual_n, 0), in_orbit(F.dual_n);
+  for (int f = 0; f < F.dual_n; f++) {
+    if (seen[f])
+      continue;
+    // the automorphisms form a group, so the orbit of f is its set of images
+    vector<int> f_orbit;
+    fill(in_orbit.begin(), in_orbit.end(), 0);
+    for (const vector<int> &perm : F.aut_faces) {
+      if (!in_orbit[perm[f]]) {
+        in_orbit[perm[f]] = 1;
+        seen[perm[f]] = 1;
+        f_orbit.push_back(perm[f]);
+      }
+    }
+    if (f_orbit.size() > orbit.size())
+      orbit = f_orbit;
+  }
+  // the first face is the one every other face of the orbit is mapped to
+  sort(orbit.begin(), orbit.end());
+  return orbit.size();
+}
@@ -0,0 +1,135 @@
+#include "include.h"
+#include <map>
+#include <sstream>
+
+// the isomers are tuned for in buckets of sizes, n = 60 to 79 and so on
+constexpr int BUCKET_WIDTH = 20;
+// passes of the sweep over the parameters, it stops early once a pass does
+// not improve on the last
+constexpr int MAX_PASSES = 2;
+
+// the values tried for each parameter, the default first
+const vector<int> PRESOLVE_VALS = {-1, 0, 1, 2};
+const vector<int> CUTS_VALS = {-1, 0, 1, 2, 3};
+const vector<int> MIP_FOCUS_VALS = {0, 1, 2, 3};
+
+// Read a file saved by --tune, one line per bucket of sizes and value of p:
+// n_first n_last p Presolve Cuts MIPFocus. Lines starting with # are comments
+void load_params(const string name, vector<Grb_params>(&params)) {
+  ifstream file(name);
+  if (!file.is_open()) {
+    throw runtime_error("\nError: Could not open file " + name);
+  }
+  string line;
+  while (getline(file, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    istringstream fields(line);
+    Grb_params par;
+    if (!(fields >> par.n_first >> par.n_last >> par.p >> par.presolve >>
+          par.cuts >> par.mip_focus)) {
+      throw runtime_error("\nError: Invalid line in " + name + ": " + line);
+    }
+    params.push_back(par);
+  }
+}
+
+// Gurobi's work to solve the sample isomers for par.p with the parameters
+// par, the solutions are thrown away
+double sample_work(const vector<Fullerene>(&sample), const Options(&opts),
+                   const Grb_params(&par), GRBEnv(&grb_env)) {
+  Options solve_opts = opts;
+  solve_opts.p_vals.assign(1, par.p);
+  solve_opts.params.assign(1, par);
+  solve_opts.binary_out = false;
+  ostream null_out(nullptr);
+  vector<Out_ptrs> out_ptrs(1);
+  out_ptrs[0].fill(&null_out);
+  vector<int> bounds, clar_nums(1);
+  vector<Clar_sol> sols(1);
+  double work = 0;
+  for (const Fullerene &F : sample) {
+    F.stats = Isomer_stats();
+    clar_upper_bounds(F, solve_opts.p_vals, bounds);
+    p_range_anionic_clar_lp(F, solve_opts, bounds, grb_env, out_ptrs,
+                            clar_nums, sols);
+    work += F.stats.grb_work;
+  }
+  return work;
+}
+
+// Sweep one parameter at a time over its values, keeping the best value
+// before moving on to the next. work is that of par, before and after
+void sweep_params(const vector<Fullerene>(&sample), const Options(&opts),
+                  Grb_params(&par), double(&work), GRBEnv(&grb_env)) {
+  int Grb_params::*const members[3] = {&Grb_params::presolve,
+                                       &Grb_params::cuts,
+                                       &Grb_params::mip_focus};
+  const vector<int> *vals[3] = {&PRESOLVE_VALS, &CUTS_VALS, &MIP_FOCUS_VALS};
+  bool improved = true;
+  for (int pass = 0; pass < MAX_PASSES && improved; pass++) {
+    improved = false;
+    for (int m = 0; m < 3; m++) {
+      for (int val : *vals[m]) {
+        if (par.*members[m] == val)
+          continue;
+        Grb_params cand = par;
+        cand.*members[m] = val;
+        const double cand_work = sample_work(sample, opts, cand, grb_env);
+        if (cand_work < work) {
+          work = cand_work;
+          par = cand;
+          improved = true;
+        }
+      }
+    }
+  }
+}
+
+// Tune the Gurobi parameters on the first isomers of each bucket of sizes in
+// the input, for every value of p, and save them to opts.tune_file
+void tune_params(const Options(&opts), Input(&in)) {
+  map<int, vector<Fullerene>> samples;
+  Fullerene F;
+  int graph_num = 0;
+  while (read_fullerene(in, F, opts.p_vals[0])) {
+    F.id = graph_num++;
+    vector<Fullerene> &sample = samples[F.n / BUCKET_WIDTH];
+    if ((int)sample.size() < opts.tune_samples) {
+      prepare_isomer(F, opts);
+      sample.push_back(F);
+    }
+  }
+
+  GRBEnv grb_env = GRBEnv(true);
+  grb_env.set(GRB_IntParam_OutputFlag, DEBUG_GUROBI);
+  grb_env.start();
+
+  ofstream file(opts.tune_file, ios::trunc);
+  if (!file.is_open()) {
+    throw runtime_error("\nError: Could not open file " + opts.tune_file);
+  }
+  file << "# n_first n_last p Presolve Cuts MIPFocus" << endl;
+  for (auto &bucket : samples) {
+    for (int p : opts.p_vals) {
+      Grb_params par;
+      par.n_first = bucket.first * BUCKET_WIDTH;
+      par.n_last = par.n_first + BUCKET_WIDTH - 1;
+      par.p = p;
+      const double default_work =
+          sample_work(bucket.second, opts, par, grb_env);
+      double work = default_work;
+      sweep_params(bucket.second, opts, par, work, grb_env);
+      file << par.n_first << " " << par.n_last << " " << par.p << " "
+           << par.presolve << " " << par.cuts << " " << par.mip_focus << endl;
+      cerr << "n = " << par.n_first << " to " << par.n_last << ", p = " << p
+           << ": work " << default_work << " with the defaults, " << work
+           << " with Presolve " << par.presolve << ", Cuts " << par.cuts
+           << ", MIPFocus " << par.mip_focus << endl;
+    }
+  }
+  file.close();
+  if (!file) {
+    throw runtime_error("\nError: Could not write file " + opts.tune_file);
+  }
+}
@@ -1,13 +1,19 @@
 #include "include.h"
+#include <fcntl.h>
+#include <sstream>
+#include <unistd.h>
 
 int main(int argc, char *argv[]) {
-  // isomer
+  // isomers are read from stdin
+  Input in(STDIN_FILENO);
   Fullerene F;
   // out files
   string out_file_names[NFILE] = {"output/pp_anionic_clar_num",
                                   "output/pp_r_pent", "output/pp_r_hex",
                                   "output/pp_match_e"};
-  ofstream out_files_ptr[NFILE];
+  ofstream out_files[NFILE];
+  ostream *out_files_ptr[NFILE];
+  get_out_ptrs(out_files, out_files_ptr);
 
   // define gurobi solve environments
   GRBEnv grb_env = GRBEnv(true);
@@ -19,15 +25,15 @@ int main(int argc, char *argv[]) {
   // the first fullerene we test is C20:1
   // C_0(C20:1) = 0
   int p = 0;
-  read_fullerene(F, 0);
-  open_out_file(p, out_file_names, out_files_ptr);
+  read_fullerene(in, F, 0);
+  open_out_file(p, out_file_names, out_files);
   F.id = graph_num;
   // construct planar dual graph
   construct_planar_dual(F, p);
   if (p_anionic_clar_lp(F, p, grb_env, out_files_ptr) != 0) {
     throw runtime_error("Failed solving C_0(C20:1)\n");
   }
-  close_files(out_files_ptr);
+  close_files(out_files);
 
   // the second fullerene we test is C60:1812
   // it has p-anionic Clar numbers
@@ -39,16 +45,655 @@ int main(int argc, char *argv[]) {
   // p = 10, 10
   // p = 12, 12
   const int clar_nums[7] = {8, 6, 6, 8, 8, 10, 12};
-  read_fullerene(F, 0);
+  read_fullerene(in, F, 0);
   construct_planar_dual(F, 0);
   F.id = graph_num;
   for (int p = 0; p < 13; p += 2) {
-    open_out_file(p, out_file_names, out_files_ptr);
+    open_out_file(p, out_file_names, out_files);
     // construct planar dual graph
     if (p_anionic_clar_lp(F, p, grb_env, out_files_ptr) != clar_nums[p / 2]) {
       throw runtime_error("Failed solving C_" + to_string(p) + "(C60:1812)\n");
     }
-    close_files(out_files_ptr);
+    close_files(out_files);
   }
+
+  // solving every value of p with one model should give the same numbers
+  Options opts;
+  vector<int> &p_vals = opts.p_vals;
+  vector<int> range_clar_nums(7);
+  vector<Clar_sol> range_sols(7);
+  vector<ostringstream> out_bufs(7 * NFILE);
+  vector<Out_ptrs> range_out_ptrs(7);
+  for (int k = 0; k < 7; k++) {
+    p_vals.push_back(2 * k);
+    for (int i = 0; i < NFILE; i++) {
+      range_out_ptrs[k][i] = &out_bufs[k * NFILE + i];
+    }
+  }
+  vector<int> range_bounds;
+  clar_upper_bounds(F, p_vals, range_bounds);
+  p_range_anionic_clar_lp(F, opts, range_bounds, grb_env, range_out_ptrs,
+                          range_clar_nums, range_sols);
+  for (int k = 0; k < 7; k++) {
+    if (range_clar_nums[k] != clar_nums[k]) {
+      throw runtime_error("Failed solving C_" + to_string(p_vals[k]) +
+                          "(C60:1812) over a range of p\n");
+    }
+  }
+
+  // as should the ILP with the matching heuristic
+  opts.match_heuristic = true;
+  p_range_anionic_clar_lp(F, opts, range_bounds, grb_env, range_out_ptrs,
+                          range_clar_nums, range_sols);
+  for (int k = 0; k < 7; k++) {
+    if (range_clar_nums[k] != clar_nums[k]) {
+      throw runtime_error("Failed solving C_" + to_string(p_vals[k]) +
+                          "(C60:1812) with the matching heuristic\n");
+    }
+  }
+
+  // as should two copies of it solved together in one model
+  const vector<const Fullerene *> batch(2, &F);
+  const vector<vector<int>> batch_bounds(2, range_bounds);
+  vector<vector<Out_ptrs>> batch_out_ptrs(2, range_out_ptrs);
+  vector<vector<int>> batch_clar_nums;
+  vector<vector<Clar_sol>> batch_sols;
+  opts.match_heuristic = false;
+  batch_anionic_clar_lp(batch, opts, batch_bounds, grb_env, batch_out_ptrs,
+                        batch_clar_nums, batch_sols);
+  for (int k = 0; k < 7; k++) {
+    if (batch_clar_nums[0][k] != clar_nums[k] ||
+        batch_clar_nums[1][k] != clar_nums[k]) {
+      throw runtime_error("Failed solving C_" + to_string(p_vals[k]) +
+                          "(C60:1812) in a batch\n");
+    }
+  }
+
+  // C60:1812 is the icosahedral buckminsterfullerene, whose automorphism group
+  // has order 120. Breaking its symmetry should not change the numbers
+  automorphisms(F, F.aut_faces);
+  if (F.aut_faces.size() != 120) {
+    throw runtime_error("Found " + to_string(F.aut_faces.size()) +
+                        " automorphisms of C60:1812\n");
+  }
+  opts.symmetry = true;
+  p_range_anionic_clar_lp(F, opts, range_bounds, grb_env, range_out_ptrs,
+                          range_clar_nums, range_sols);
+  for (int k = 0; k < 7; k++) {
+    if (range_clar_nums[k] != clar_nums[k]) {
+      throw runtime_error("Failed solving C_" + to_string(p_vals[k]) +
+                          "(C60:1812) with symmetry breaking\n");
+    }
+  }
+
+  // the upper bounds should hold, and meet the Clar numbers for p = 0 (the
+  // bound (n - 12) / 6) and p = 12. There is no structure for odd p
+  vector<int> bounds, odd_bounds;
+  vector<string> odd_certs;
+  clar_upper_bounds(F, p_vals, bounds);
+  clar_upper_bounds(F, vector<int>(1, 3), odd_bounds, odd_certs);
+  for (int k = 0; k < 7; k++) {
+    if (bounds[k] < clar_nums[k] || odd_bounds[0] != -1 ||
+        odd_certs[0] != "odd" ||
+        ((k == 0 || k == 6) && bounds[k] != clar_nums[k])) {
+      throw runtime_error("Wrong upper bound on C_" + to_string(p_vals[k]) +
+                          "(C60:1812)\n");
+    }
+  }
+  // the Lagrangian relaxation may only tighten them
+  vector<int> screened;
+  vector<string> certs;
+  opts.screen = true;
+  screen_bounds(F, opts, screened, certs);
+  opts.screen = false;
+  for (int k = 0; k < 7; k++) {
+    if (screened[k] < clar_nums[k] || screened[k] > bounds[k]) {
+      throw runtime_error("Wrong screened bound on C_" + to_string(p_vals[k]) +
+                          "(C60:1812)\n");
+    }
+  }
+
+  // the heuristic should find a structure, no larger than a Clar structure
+  for (int k = 0; k < 7; k++) {
+    const int num_res_faces =
+        heuristic_anionic_clar(F, p_vals[k], range_sols[k]);
+    if (num_res_faces == -1 || num_res_faces > clar_nums[k] ||
+        check_if_sol_valid(F, p_vals[k], range_sols[k]) != num_res_faces) {
+      throw runtime_error("Wrong heuristic structure for C_" +
+                          to_string(p_vals[k]) + "(C60:1812)\n");
+    }
+  }
+
+  // the 12 pentagons cover every vertex, so adding a hexagon covers some twice
+  Clar_sol bad_sol;
+  bad_sol.res_face = F.pent_mask;
+  bad_sol.match_e.assign(F.num_edges);
+  bad_sol.res_face.set(F.hexes[0]);
+  bool rejected = false;
+  try {
+    check_if_sol_valid(F, 12, bad_sol);
+  } catch (runtime_error &e) {
+    rejected = true;
+  }
+  if (!rejected) {
+    throw runtime_error("Accepted an invalid structure of C60:1812\n");
+  }
+
+  // the native branch and bound should agree with the ILP
+  vector<int> native_clar_nums(7);
+  p_range_anionic_clar_native(F, opts, range_bounds, range_out_ptrs,
+                              native_clar_nums, range_sols);
+  for (int k = 0; k < 7; k++) {
+    if (native_clar_nums[k] != clar_nums[k]) {
+      throw runtime_error("Failed solving C_" + to_string(p_vals[k]) +
+                          "(C60:1812) by branch and bound\n");
+    }
+  }
+  // the 12 pentagons of C60:1812 cover every vertex, so they are its only
+  // 12-anionic Clar structure. Every value of p has one
+  vector<Clar_count> counts;
+  clar_structures(F, p_vals, native_clar_nums, true, counts);
+  for (int k = 0; k < 7; k++) {
+    if (counts[k].num_face_sets < 1 ||
+        counts[k].num_structures < counts[k].num_face_sets ||
+        (k == 6 && (counts[k].num_structures != 1 ||
+                    counts[k].face_sets[0] != F.pents))) {
+      throw runtime_error("Wrong number of Clar structures of C_" +
+                          to_string(p_vals[k]) + "(C60:1812)\n");
+    }
+  }
+  // counting them by the transfer matrix, without listing them, should give
+  // the same numbers
+  vector<Clar_count> totals;
+  clar_structures(F, p_vals, native_clar_nums, false, totals);
+  for (int k = 0; k < 7; k++) {
+    if (totals[k].num_face_sets != counts[k].num_face_sets ||
+        totals[k].num_structures != counts[k].num_structures) {
+      throw runtime_error("Wrong count of Clar structures of C_" +
+                          to_string(p_vals[k]) + "(C60:1812)\n");
+    }
+  }
+
+  // relabelling the vertices and mirroring the embedding should not change
+  // the canonical form
+  Fullerene G;
+  G.Resize(F.n);
+  vector<int> relabel(F.n);
+  for (int v = 0; v < F.n; v++) {
+    relabel[v] = (7 * v + 3) % F.n;
+  }
+  for (int v = 0; v < F.n; v++) {
+    for (int j = 0; j < 3; j++) {
+      G.primal[relabel[v]].adj_v[j] = relabel[F.primal[v].adj_v[2 - j]];
+      G.primal[relabel[v]].faces[j] = -1;
+    }
+  }
+  construct_planar_dual(G, 0);
+  G.id = graph_num;
+  Canon canon, G_canon;
+  canonical_form(F, canon);
+  canonical_form(G, G_canon);
+  if (canon.code != G_canon.code) {
+    throw runtime_error("Canonical form of C60:1812 depends on its labels\n");
+  }
+
+  // structures cached for C60:1812 should be read back from the file and
+  // mapped onto the relabelled copy
+  const string cache_name = "output/pp_cache";
+  remove(cache_name.c_str());
+  {
+    Clar_cache cache(cache_name);
+    for (int k = 0; k < 7; k++) {
+      cache.store(F, canon, p_vals[k], native_clar_nums[k], range_sols[k]);
+    }
+  }
+  Clar_cache cache(cache_name);
+  for (int k = 0; k < 7; k++) {
+    int num_res_faces;
+    Clar_sol sol;
+    if (!cache.lookup(G, G_canon, p_vals[k], num_res_faces, sol) ||
+        num_res_faces != clar_nums[k] ||
+        check_if_sol_valid(G, p_vals[k], sol) != num_res_faces) {
+      throw runtime_error("Wrong cached structure for C_" +
+                          to_string(p_vals[k]) + "(C60:1812)\n");
+    }
+  }
+  int num_res_faces;
+  if (cache.lookup(G, G_canon, 1, num_res_faces, bad_sol)) {
+    throw runtime_error("Found an uncached value of p for C60:1812\n");
+  }
+  remove(cache_name.c_str());
+  // a structure without resonant faces keeps its perfect matching, and no
+  // structure (odd p) is read back as an empty solution
+  Matching kekule(F);
+  Clar_sol kekule_sol;
+  kekule_sol.res_face.assign(F.dual_n);
+  kekule.is_perfect();
+  kekule.get_edges(kekule_sol.match_e);
+  {
+    Clar_cache zero_cache(cache_name);
+    zero_cache.store(F, canon, 0, 0, kekule_sol);
+    zero_cache.store(F, canon, 3, 0, Clar_sol());
+  }
+  Clar_cache zero_cache(cache_name);
+  Clar_sol zero_sol, odd_sol;
+  if (!zero_cache.lookup(G, G_canon, 0, num_res_faces, zero_sol) ||
+      num_res_faces != 0 || zero_sol.match_e.count() != F.n / 2 ||
+      check_if_sol_valid(G, 0, zero_sol) != 0 ||
+      !zero_cache.lookup(G, G_canon, 3, num_res_faces, odd_sol) ||
+      num_res_faces != 0 || !odd_sol.match_e.empty()) {
+    throw runtime_error("Wrong cached structure without resonant faces for "
+                        "C60:1812\n");
+  }
+  remove(cache_name.c_str());
+
+  // the input layer should read signed integers across any white space, and
+  // stop where the next token is not an integer without skipping it, both
+  // from a memory mapped file and through the buffer of a pipe
+  const string text = "  12\n-7\t+3 0\r\n abc";
+  const int text_ints[4] = {12, -7, 3, 0};
+  const string text_name = "output/pp_input";
+  ofstream text_file(text_name, ios::trunc);
+  text_file << text;
+  text_file.close();
+  int pipe_fds[2];
+  if (pipe(pipe_fds) != 0 ||
+      write(pipe_fds[1], text.data(), text.size()) != (ssize_t)text.size()) {
+    throw runtime_error("Could not write the input to a pipe\n");
+  }
+  close(pipe_fds[1]);
+  const int text_fds[2] = {open(text_name.c_str(), O_RDONLY), pipe_fds[0]};
+  for (int t = 0; t < 2; t++) {
+    Input text_in(text_fds[t]);
+    const string source = t == 0 ? "a file" : "a pipe";
+    int x;
+    for (int i = 0; i < 4; i++) {
+      if (!text_in.next_int(x) || x != text_ints[i]) {
+        throw runtime_error("Misread integer " + to_string(i) + " from " +
+                            source + "\n");
+      }
+    }
+    if (text_in.is_mapped() != (t == 0) || text_in.format() != ADJ_LIST ||
+        text_in.next_int(x) || text_in.offset() != text.size() - 3) {
+      throw runtime_error("Read past the end of the integers from " + source +
+                          "\n");
+    }
+    close(text_fds[t]);
+  }
+  remove(text_name.c_str());
+
+  // two copies of C60:1812 written as planar_code, in 1 byte entries and in
+  // 2 byte entries of either byte order, should be read back with the same
+  // neighbours in the same order. The header gives the format and byte order
+  const string code_name = "output/pp_planar_code";
+  const string orders[4] = {"", " le", " be", " xx"};
+  for (int o = 0; o < 4; o++) {
+    const bool wide = o > 0;
+    vector<unsigned> entries(1, F.n);
+    for (int v = 0; v < F.n; v++) {
+      for (int j = 0; j < 3; j++) {
+        entries.push_back(F.primal[v].adj_v[j] + 1);
+      }
+      entries.push_back(0);
+    }
+    string code;
+    if (wide)
+      code += '\0';
+    for (unsigned x : entries) {
+      if (!wide) {
+        code += (char)x;
+      } else if (orders[o] == " be") {
+        code += (char)(x >> 8);
+        code += (char)(x & 0xff);
+      } else {
+        code += (char)(x & 0xff);
+        code += (char)(x >> 8);
+      }
+    }
+    ofstream code_file(code_name, ios::trunc | ios::binary);
+    code_file << ">>planar_code" + orders[o] + "<<" << code << code;
+    code_file.close();
+    const int code_fd = open(code_name.c_str(), O_RDONLY);
+    // an unknown byte order is rejected
+    if (orders[o] == " xx") {
+      bool rejected = false;
+      try {
+        Input code_in(code_fd);
+      } catch (runtime_error &e) {
+        rejected = true;
+      }
+      close(code_fd);
+      if (!rejected) {
+        throw runtime_error("Accepted an unknown planar_code byte order\n");
+      }
+      continue;
+    }
+    Input code_in(code_fd);
+    if (code_in.format() != PLANAR_CODE) {
+      throw runtime_error("Did not detect the planar_code header" +
+                          orders[o] + "\n");
+    }
+    for (int copy = 0; copy < 2; copy++) {
+      Fullerene H;
+      if (!read_fullerene(code_in, H, 0) || H.n != F.n) {
+        throw runtime_error("Could not read C60:1812 as planar_code" +
+                            orders[o] + "\n");
+      }
+      for (int v = 0; v < F.n; v++) {
+        for (int j = 0; j < 3; j++) {
+          if (H.primal[v].adj_v[j] != F.primal[v].adj_v[j]) {
+            throw runtime_error("Misread C60:1812 as planar_code" +
+                                orders[o] + "\n");
+          }
+        }
+      }
+    }
+    Fullerene H;
+    if (read_fullerene(code_in, H, 0)) {
+      throw runtime_error("Read past the end of the planar_code" + orders[o] +
+                          "\n");
+    }
+    close(code_fd);
+  }
+  remove(code_name.c_str());
+
+  // binary records of two copies of C60:1812, one with a 6-anionic Clar
+  // structure and one without a structure, should be converted to the same
+  // rows as writing the text out files directly
+  const string adj_name = "output/pp_adj";
+  ofstream adj_file(adj_name, ios::trunc);
+  for (int copy = 0; copy < 2; copy++) {
+    adj_file << F.n << endl;
+    for (int v = 0; v < F.n; v++) {
+      adj_file << 3;
+      for (int j = 0; j < 3; j++) {
+        adj_file << " " << F.primal[v].adj_v[j];
+      }
+      adj_file << endl;
+    }
+  }
+  adj_file.close();
+  string bin_name;
+  ofstream bin_file;
+  remove("output/06_clar_sol.bin.test");
+  open_bin_file(6, ".test", bin_name, bin_file);
+  save_sol_bin(F, clar_nums[3], range_sols[3], bin_file);
+  save_sol_bin(F, 0, Clar_sol(), bin_file);
+  bin_file.close();
+  ostringstream text_rows[NFILE];
+  ostream *text_ptrs[NFILE];
+  for (int i = 0; i < NFILE; i++) {
+    text_ptrs[i] = &text_rows[i];
+  }
+  save_sol(F, 6, clar_nums[3], range_sols[3], text_ptrs);
+  save_sol(F, 6, 0, Clar_sol(), text_ptrs);
+  // the rows are appended to the text out files, which are cut back to their
+  // old sizes after
+  string text_names[4] = {"output/pp_anionic_clar_num", "output/pp_r_pent",
+                          "output/pp_r_hex", "output/pp_match_e"};
+  streamoff text_sizes[4];
+  for (int i = 0; i < 4; i++) {
+    get_out_name(6, text_names[i]);
+    ifstream existing(text_names[i], ios::ate);
+    text_sizes[i] = existing.is_open() ? (streamoff)existing.tellg() : 0;
+  }
+  const int adj_fd = open(adj_name.c_str(), O_RDONLY);
+  {
+    Input adj_in(adj_fd);
+    bin_to_text(bin_name, adj_in);
+  }
+  close(adj_fd);
+  for (int i = 0; i < 4; i++) {
+    ifstream converted(text_names[i]);
+    converted.seekg(text_sizes[i]);
+    ostringstream rows;
+    rows << converted.rdbuf();
+    if (rows.str() != text_rows[i].str() ||
+        truncate(text_names[i].c_str(), text_sizes[i]) != 0) {
+      throw runtime_error("Wrong rows converted from " + bin_name + " to " +
+                          text_names[i] + "\n");
+    }
+  }
+  remove(adj_name.c_str());
+  remove(bin_name.c_str());
+
+  // rows written after a checkpoint should be dropped on resume, so that
+  // writing them again gives the same out files as a run without a stop. The
+  // files of a shard are used to keep clear of the out files above
+  Options ckpt_opts;
+  ckpt_opts.p_vals.assign(1, 6);
+  ckpt_opts.shard = 1;
+  ckpt_opts.num_shards = 2;
+  const string ckpt_name = "output/06_checkpoint.1_of_2";
+  remove(ckpt_name.c_str());
+  int next_id;
+  size_t offset;
+  if (load_checkpoint(ckpt_opts, next_id, offset)) {
+    throw runtime_error("Loaded a checkpoint that was never saved\n");
+  }
+  ostringstream first_rows[NFILE];
+  ostream *first_ptrs[NFILE];
+  for (int i = 0; i < NFILE; i++) {
+    first_ptrs[i] = &first_rows[i];
+  }
+  save_sol(F, 6, clar_nums[3], range_sols[3], first_ptrs);
+  // a run that writes a row past its checkpoint and stops
+  for (int i = 0; i < 4; i++) {
+    remove((text_names[i] + shard_suffix(ckpt_opts)).c_str());
+  }
+  Out_files ckpt_out;
+  Out_ptrs ckpt_ptrs;
+  open_out_files(ckpt_opts, ckpt_out);
+  for (int i = 0; i < NFILE; i++) {
+    ckpt_ptrs[i] = &ckpt_out.files[0][i];
+  }
+  write_sol(F, ckpt_opts, 6, clar_nums[3], range_sols[3], ckpt_ptrs.data());
+  save_checkpoint(ckpt_opts, ckpt_out, 1, 123);
+  write_sol(F, ckpt_opts, 6, 0, Clar_sol(), ckpt_ptrs.data());
+  close_out_files(ckpt_out);
+  if (!load_checkpoint(ckpt_opts, next_id, offset) || next_id != 1 ||
+      offset != 123) {
+    throw runtime_error("Wrong checkpoint loaded from " + ckpt_name + "\n");
+  }
+  for (int i = 0; i < 4; i++) {
+    ifstream truncated(ckpt_out.names[0][i]);
+    ostringstream rows;
+    rows << truncated.rdbuf();
+    if (rows.str() != first_rows[i].str()) {
+      throw runtime_error("Did not truncate " + ckpt_out.names[0][i] +
+                          " to its checkpoint\n");
+    }
+  }
+  // the resumed run writes the row again
+  open_out_files(ckpt_opts, ckpt_out);
+  for (int i = 0; i < NFILE; i++) {
+    ckpt_ptrs[i] = &ckpt_out.files[0][i];
+  }
+  write_sol(F, ckpt_opts, 6, 0, Clar_sol(), ckpt_ptrs.data());
+  close_out_files(ckpt_out);
+  for (int i = 0; i < 4; i++) {
+    ifstream resumed(ckpt_out.names[0][i]);
+    ostringstream rows;
+    rows << resumed.rdbuf();
+    if (rows.str() != text_rows[i].str()) {
+      throw runtime_error("Wrong rows in " + ckpt_out.names[0][i] +
+                          " after resuming\n");
+    }
+    remove(ckpt_out.names[0][i].c_str());
+  }
+  remove(ckpt_name.c_str());
+
+  // 5 isomers split into 3 shards should be read in blocks of 1, 2 and 2
+  // isomers, and the rows of the shards merged back in the order of the
+  // isomers. The relabelled copy of C60:1812 tells the isomers apart. The
+  // first shard saves the offsets of the isomers to an index file, the
+  // others read their blocks from it
+  const Fullerene *isomers[5] = {&F, &G, &G, &F, &G};
+  adj_file.open(adj_name, ios::trunc);
+  for (const Fullerene *I : isomers) {
+    adj_file << I->n << endl;
+    for (int v = 0; v < I->n; v++) {
+      adj_file << 3;
+      for (int j = 0; j < 3; j++) {
+        adj_file << " " << I->primal[v].adj_v[j];
+      }
+      adj_file << endl;
+    }
+  }
+  adj_file.close();
+  Options shard_opts;
+  shard_opts.p_vals.assign(1, 1);
+  shard_opts.num_shards = 3;
+  shard_opts.index_file = "output/pp_index";
+  remove(shard_opts.index_file.c_str());
+  string merged_names[4] = {"output/pp_anionic_clar_num", "output/pp_r_pent",
+                            "output/pp_r_hex", "output/pp_match_e"};
+  for (int i = 0; i < 4; i++) {
+    get_out_name(1, merged_names[i]);
+    remove(merged_names[i].c_str());
+  }
+  for (int s = 0; s < 3; s++) {
+    remove(("output/01_shard." + to_string(s) + "_of_3").c_str());
+  }
+  const int block_starts[4] = {0, 1, 3, 5};
+  for (int s = 0; s < 3; s++) {
+    shard_opts.shard = s;
+    const int shard_fd = open(adj_name.c_str(), O_RDONLY);
+    Input shard_in(shard_fd);
+    int first_id, end_id;
+    shard_input(shard_opts, shard_in, first_id, end_id);
+    if (first_id != block_starts[s] || end_id != block_starts[s + 1]) {
+      throw runtime_error("Wrong block of isomers for shard " + to_string(s) +
+                          "\n");
+    }
+    Out_files shard_out;
+    open_out_files(shard_opts, shard_out);
+    Fullerene H;
+    int id = first_id;
+    for (; read_fullerene(shard_in, H, 1); id++) {
+      for (int v = 0; id < end_id && v < H.n; v++) {
+        for (int j = 0; j < 3; j++) {
+          if (H.primal[v].adj_v[j] != isomers[id]->primal[v].adj_v[j]) {
+            throw runtime_error("Shard " + to_string(s) + " misread isomer " +
+                                to_string(id) + "\n");
+          }
+        }
+      }
+      for (int i = 0; i < 4; i++) {
+        shard_out.files[0][i] << id << endl;
+      }
+    }
+    close(shard_fd);
+    if (id != end_id) {
+      throw runtime_error("Shard " + to_string(s) + " read up to isomer " +
+                          to_string(id) + "\n");
+    }
+    close_out_files(shard_out);
+    // the shards can only be merged once every one of them has finished
+    if (s == 2) {
+      bool rejected = false;
+      shard_opts.merge_shards = 3;
+      try {
+        merge_shards(shard_opts);
+      } catch (runtime_error &e) {
+        rejected = true;
+      }
+      if (!rejected) {
+        throw runtime_error("Merged shards before the last one finished\n");
+      }
+    }
+    save_shard_range(shard_opts, first_id, end_id);
+  }
+  // a header, the size of the input, the number of isomers and their offsets
+  ifstream index_file(shard_opts.index_file, ios::binary | ios::ate);
+  if (index_file.tellg() != (streamoff)string(">>clar_index<<").size() + 56) {
+    throw runtime_error("Wrong size of the index of the shards\n");
+  }
+  index_file.close();
+  remove(shard_opts.index_file.c_str());
+  merge_shards(shard_opts);
+  for (int i = 0; i < 4; i++) {
+    ifstream merged(merged_names[i]);
+    ostringstream rows;
+    rows << merged.rdbuf();
+    if (rows.str() != "0\n1\n2\n3\n4\n") {
+      throw runtime_error("Wrong rows merged into " + merged_names[i] + "\n");
+    }
+    remove(merged_names[i].c_str());
+    for (int s = 0; s < 3; s++) {
+      shard_opts.shard = s;
+      remove((merged_names[i] + shard_suffix(shard_opts)).c_str());
+    }
+  }
+  for (int s = 0; s < 3; s++) {
+    remove(("output/01_shard." + to_string(s) + "_of_3").c_str());
+  }
+
+  // with --stdout each isomer and value of p gets a line of its id, p and the
+  // rows of the out files, in the order of the isomers even when they are
+  // solved by several threads. The run without it writes the files of a shard
+  Options stdout_opts;
+  stdout_opts.p_vals = {6, 12};
+  stdout_opts.engine = NATIVE;
+  stdout_opts.num_threads = 3;
+  stdout_opts.shard = 1;
+  stdout_opts.num_shards = 2;
+  ostringstream stdout_lines;
+  Out_files pipe_out;
+  for (int run = 0; run < 2; run++) {
+    stdout_opts.to_stdout = run == 0;
+    const int pipe_fd = open(adj_name.c_str(), O_RDONLY);
+    Input pipe_in(pipe_fd);
+    Clar_cache no_cache("");
+    Stats_log log(stdout_opts, pipe_in, 0);
+    Run_stats run_stats;
+    if (run == 1) {
+      for (int k = 0; k < 2; k++) {
+        for (int i = 0; i < 4; i++) {
+          string name = text_names[i] + shard_suffix(stdout_opts);
+          get_out_name(stdout_opts.p_vals[k], name);
+          remove(name.c_str());
+        }
+      }
+    }
+    open_out_files(stdout_opts, pipe_out);
+    streambuf *cout_buf = cout.rdbuf(stdout_lines.rdbuf());
+    const int num_written = run_pipeline(stdout_opts, pipe_in, pipe_out,
+                                         no_cache, log, 0, run_stats);
+    cout.rdbuf(cout_buf);
+    close_out_files(pipe_out);
+    close(pipe_fd);
+    if (num_written != 5) {
+      throw runtime_error("Wrote " + to_string(num_written) +
+                          " isomers with --stdout " + to_string(run) + "\n");
+    }
+  }
+  string expected_lines;
+  vector<vector<ifstream>> pipe_files(2);
+  for (int k = 0; k < 2; k++) {
+    for (int i = 0; i < 4; i++) {
+      pipe_files[k].emplace_back(pipe_out.names[k][i]);
+    }
+  }
+  for (int id = 0; id < 5; id++) {
+    for (int k = 0; k < 2; k++) {
+      expected_lines += to_string(id) + " " + to_string(stdout_opts.p_vals[k]);
+      for (int i = 0; i < 4; i++) {
+        string row;
+        getline(pipe_files[k][i], row);
+        expected_lines += " " + row;
+      }
+      expected_lines += "\n";
+    }
+  }
+  if (stdout_lines.str() != expected_lines) {
+    throw runtime_error("Wrong lines written to stdout\n");
+  }
+  for (int k = 0; k < 2; k++) {
+    for (int i = 0; i < 4; i++) {
+      remove(pipe_out.names[k][i].c_str());
+    }
+  }
+  remove(adj_name.c_str());
   cout << "Successfully solved ILPs\n";
 }